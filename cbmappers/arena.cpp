@@ -0,0 +1,73 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "arena.h"
+
+using namespace std;
+
+Arena::Arena(size_t block_size, size_t limit) {
+	this->block_size = block_size;
+	this->limit = limit;
+	current = 0;
+	offset = 0;
+	spent = 0;
+	total = 0;
+}
+
+Arena::~Arena() {
+	for (unsigned int i = 0; i < blocks.size(); i++) {
+		delete[] blocks[i].memory;
+	}
+}
+
+void *Arena::allocate(size_t bytes) {
+	// Round up so the next allocation stays aligned as well; the blocks
+	// themselves come from new[], which aligns to at least ALIGN
+	bytes = (bytes + ALIGN - 1) & ~(ALIGN - 1);
+	
+	// Try the current block, then the ones kept from before the reset
+	while (current < blocks.size()) {
+		if (offset + bytes <= blocks[current].size) {
+			void *p = blocks[current].memory + offset;
+			offset += bytes;
+			return p;
+		}
+		spent += blocks[current].size;
+		current++;
+		offset = 0;
+	}
+	
+	// Take a new block; large requests get a block of their own size
+	Block b;
+	b.size = (bytes > block_size) ? bytes : block_size;
+	if (limit > 0 && total + b.size > limit) {
+		throw "Arena limit exceeded";
+	}
+	b.memory = new unsigned char[b.size];
+	blocks.push_back(b);
+	total += b.size;
+	current = blocks.size() - 1;
+	offset = bytes;
+	return b.memory;
+}
+
+void Arena::reset() {
+	current = 0;
+	offset = 0;
+	spent = 0;
+}
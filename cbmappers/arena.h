@@ -0,0 +1,137 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef arena_h
+#define arena_h
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+/**
+* Bump allocator for everything one conversion needs: the layers of the
+* model, the entity tables, the decompressed data and the image. Memory
+* is handed out from large blocks and is never freed one piece at a
+* time; reset() makes all of it available again in O(1), keeping the
+* blocks, so converting file after file with the same arena stops
+* asking the system for memory once the largest file has been seen.
+* An arena is not thread-safe.
+*/
+class Arena {
+	public:
+		/**
+		* Constructor. No memory is taken until the first allocation.
+		* @param block_size Size of each block taken from the system
+		* @param limit Most bytes the arena may take from the system in
+		* total, or 0 for no limit
+		*/
+		Arena(size_t block_size = DEFAULT_BLOCK_SIZE, size_t limit = 0);
+		~Arena();
+		
+		/**
+		* Returns `bytes' bytes of uninitialised memory, aligned to ALIGN
+		* bytes. The memory stays valid until reset() or until the arena
+		* is destroyed.
+		* @throws const char* if that would take the arena over its limit
+		*/
+		void *allocate(size_t bytes);
+		
+		/**
+		* Makes all memory available again. Nothing allocated before may
+		* be used after this.
+		*/
+		void reset();
+		
+		/**
+		* Returns the number of bytes in use since the last reset(),
+		* including padding and the unused ends of full blocks
+		*/
+		size_t used() const { return spent + offset; }
+		
+		/**
+		* Returns the number of bytes taken from the system
+		*/
+		size_t capacity() const { return total; }
+		
+		static const size_t ALIGN = 16;
+		static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+	
+	private:
+		typedef struct {
+			unsigned char *memory;
+			size_t size;
+		} Block;
+		
+		// Copying would free the blocks twice
+		Arena(const Arena &);
+		Arena &operator=(const Arena &);
+		
+		std::vector<Block> blocks;
+		size_t current; // block allocations come from
+		size_t offset;  // first free byte in the current block
+		size_t spent;   // bytes in the blocks before the current one
+		size_t total;
+		size_t block_size;
+		size_t limit;
+};
+
+/**
+* Allocator for the standard containers that takes its memory from an
+* arena, so a std::vector can live in one. Without an arena it falls
+* back to new and delete.
+*/
+template <class T>
+class ArenaAllocator {
+	public:
+		typedef T value_type;
+		
+		ArenaAllocator(Arena *arena = NULL) {
+			this->arena = arena;
+		}
+		
+		template <class U>
+		ArenaAllocator(const ArenaAllocator<U> &other) {
+			arena = other.arena;
+		}
+		
+		T *allocate(size_t n) {
+			if (arena) {
+				return (T *)arena->allocate(n * sizeof(T));
+			}
+			return (T *)::operator new(n * sizeof(T));
+		}
+		
+		void deallocate(T *p, size_t) {
+			// The arena frees everything at once in reset()
+			if (!arena) {
+				::operator delete(p);
+			}
+		}
+		
+		bool operator==(const ArenaAllocator &other) const {
+			return arena == other.arena;
+		}
+		
+		bool operator!=(const ArenaAllocator &other) const {
+			return arena != other.arena;
+		}
+		
+		Arena *arena;
+};
+
+#endif /* arena_h */
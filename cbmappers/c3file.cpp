@@ -19,30 +19,38 @@
 #include "c3file.h"
 #include "pkwareinputstream.h"
 #include <fstream>
+#include <string.h>
 
 using namespace std;
 
-C3File::C3File(string filename) {
-	in = new ifstream();
+C3File::C3File(string filename, Arena *arena) {
+	this->arena = arena;
+	in.reset(new ifstream());
 	in->open(filename.c_str(), ios::in | ios::binary);
 	if (!in->is_open()) {
 		throw "Can't read file";
 	}
+	file.reset(new MappedFile(filename));
 }
 
-C3File::~C3File() {
-	delete in;
+unique_ptr<IndexedPNGImage> C3File::getImage() {
+	unique_ptr<MapModel> model = getModel();
+	if (!model) {
+		return NULL;
+	}
+	return drawModel(model.get());
 }
 
-PNGImage *C3File::getImage() {
+unique_ptr<MapModel> C3File::getModel() {
 	if (!in->is_open()) {
 		return NULL;
 	}
 	
-	// Init grids for use
-	Grid<unsigned short> *buildings = NULL, *terrain = NULL;
-	Grid<unsigned char> *edges = NULL, *random = NULL;
-	Walker *walkers = NULL;
+	// Holds the decompressed grids; the views point into it
+	ChunkDecoder chunks(0, arena);
+	GridView<unsigned short> buildings, terrain;
+	GridView<unsigned char> edges, random;
+	int c_walkers = -1;
 	int mapsize, climate;
 	bool is_scenario = false;
 
@@ -55,41 +63,64 @@ PNGImage *C3File::getImage() {
 	if (is_scenario) {
 		in->seekg(0, ios::beg);
 		// mapfiles don't have building numbers, or is it the first X*X shorts?
-		buildings = readShortGrid();
-		edges = readByteGrid();
-		terrain = readShortGrid();
+		buildings = viewShortGrid();
+		edges = viewByteGrid();
+		terrain = viewShortGrid();
 		in->seekg(26244, ios::cur); // useless zero grid
-		random = readByteGrid();
+		random = viewByteGrid();
 		// Mapsize and climate are easy here
 		in->seekg(0x335b4, ios::beg);
 		mapsize = readIntFromStream();
 		in->seekg(0x33ad8, ios::beg);
 		climate = in->peek(); // use peek as shortcut: we only need 1 byte
 	} else {
-		try {
-			buildings = readCompressedShortGrid();
-			edges     = readCompressedByteGrid();
-			skipCompressed(); // building IDs
-			terrain   = readCompressedShortGrid();
-			random     = getRandomData();
-			walkers = getWalkers();
-		} catch (PKException) {
-			if (buildings) delete buildings;
-			if (edges)     delete edges;
-			if (terrain)   delete terrain;
-			if (random)    delete random;
-			if (walkers)   delete walkers;
-			throw;
-		}
+		// Compressed chunks are only located while walking through the
+		// file, and decompressed all at once afterwards
+		int c_buildings = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE * 2);
+		int c_edges     = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE);
+		skipCompressed(); // building IDs
+		int c_terrain   = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE * 2);
+		random = getRandomData();
+		c_walkers = queueWalkers(&chunks);
 		getMapsizeAndClimate(&mapsize, &climate);
+		
+		if (!chunks.run()) {
+			throw PKException("Invalid compressed data");
+		}
+		buildings = viewShortGrid(chunks.data(c_buildings));
+		edges     = viewByteGrid(chunks.data(c_edges));
+		terrain   = viewShortGrid(chunks.data(c_terrain));
 	}
 	// Lil' sanity check
 	if (mapsize > MAX_MAPSIZE) {
 		throw "Map size invalid!";
 	}
 	
-	colours = new Caesar3Colours(climate);
-	PNGImage *img = new PNGImage(mapsize * 2, mapsize * 2);
+	unique_ptr<MapModel> model(new MapModel(MAX_MAPSIZE, mapsize, MAP_SQUARE, arena));
+	MapModel::load(&model->building_grid, buildings);
+	MapModel::load(&model->edges, edges);
+	MapModel::load(&model->terrain, terrain);
+	MapModel::load(&model->random, random);
+	if (c_walkers != -1) {
+		readWalkers(chunks.data(c_walkers), &model->walkers);
+	}
+	model->climate = climate;
+	return model;
+}
+
+/**
+* Draws the minimap of a parsed map
+*/
+unique_ptr<IndexedPNGImage> C3File::drawModel(const MapModel *model) {
+	const MapGrid<unsigned int> &terrain = model->terrain;
+	const MapGrid<unsigned int> &buildings = model->building_grid;
+	const MapGrid<unsigned char> &edges = model->edges;
+	const MapGrid<unsigned char> &random = model->random;
+	int mapsize = model->mapsize;
+	
+	colours.reset(new Caesar3Colours(model->climate));
+	unique_ptr<IndexedPNGImage> img(new IndexedPNGImage(mapsize * 2, mapsize * 2,
+		colours->palette(), colours->paletteSize(), arena));
 	int border = (MAX_MAPSIZE - mapsize) / 2;
 	int max = border + mapsize;
 	int c1, c2;
@@ -98,59 +129,56 @@ PNGImage *C3File::getImage() {
 	unsigned short t_terrain, t_building;
 	
 	for (int y = border; y < max; y++) {
+		// Rows of the layers start at x = border
+		const unsigned int *terrain_row = terrain.row(y);
+		const unsigned int *building_row = buildings.row(y);
+		const unsigned char *edge_row = edges.row(y);
+		const unsigned char *random_row = random.row(y);
 		for (int x = border; x < max; x++) {
-			t_terrain  = terrain->get(x, y);
-			t_building = buildings->get(x, y);
+			t_terrain  = terrain_row[x - border];
+			t_building = building_row[x - border];
 			
 			if (t_terrain & 0x8 && t_building != 0xc69) { // building & is not fort ground
-				t_edge = edges->get(x, y);
-				t_edge_below = edges->get(x, y+1);
-				t_edge_right = edges->get(x+1, y);
+				t_edge = edge_row[x - border];
+				t_edge_below = edges.get(x, y+1); // may be in the margin
+				t_edge_right = edges.get(x+1, y);
 				getBuildingColours(t_building, t_edge, t_edge_right, t_edge_below, &c1, &c2);
 			} else if (!(t_terrain & 64) && t_building >= 0x029c && t_building < 0x02b8) {
 				// Terrain is an aquaduct *without* road beneath it
-				c1 = colours->colour(Caesar3Colours::MAP_AQUA, 0);
-				c2 = colours->colour(Caesar3Colours::MAP_AQUA, 1);
+				c1 = colours->index(Caesar3Colours::MAP_AQUA, 0);
+				c2 = colours->index(Caesar3Colours::MAP_AQUA, 1);
 			} else {
-				t_random = random->get(x, y);
+				t_random = random_row[x - border];
 				getTerrainColours(t_terrain, t_random, &c1, &c2);
 			}
 			
 			// Set pixel colours
 			getBitmapCoordinates(x-border, y-border, mapsize, &coords[0], &coords[1]);
-			img->setRGB(coords[0], coords[1], c1);
-			img->setRGB(coords[0]+1, coords[1], c2);
+			img->setIndex(coords[0], coords[1], c1);
+			img->setIndex(coords[0]+1, coords[1], c2);
 		}
 	}
-	delete terrain;
-	delete random;
-	delete buildings;
-	delete edges;
 
-	// Only do the walkers for saved games
-	if (walkers) {
-		// Get walkers
-		int colour;
-		for (int i = 0; i < MAX_WALKERS; i++) {
-			if (walkers[i].type == 0x45) { // wolf
-				colour = colours->colour(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_WOLF);
-			} else if (walkers[i].type == 0xb || walkers[i].type == 0xc || walkers[i].type == 0xd) { // our soldiers
-				colour = colours->colour(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_SOLDIER);
-			} else if (walkers[i].type == 0x31) { // barbarians
-				colour = colours->colour(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_BARBARIAN);
-			} else if (walkers[i].type == 0x2d || walkers[i].type == 0x2f) { // enemies
-				colour = colours->colour(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_ENEMY);
-			} else {
-				// Normal walkers don't show up
-				continue;
-			}
-			getBitmapCoordinates(walkers[i].x, walkers[i].y, mapsize, &coords[0], &coords[1]);
-			img->setRGB(coords[0], coords[1], colour);
-			img->setRGB(coords[0]+1, coords[1], colour);
+	// Only saved games have walkers
+	int colour;
+	for (unsigned int i = 0; i < model->walkers.size(); i++) {
+		const Walker &walker = model->walkers[i];
+		if (walker.type == 0x45) { // wolf
+			colour = colours->index(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_WOLF);
+		} else if (walker.type == 0xb || walker.type == 0xc || walker.type == 0xd) { // our soldiers
+			colour = colours->index(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_SOLDIER);
+		} else if (walker.type == 0x31) { // barbarians
+			colour = colours->index(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_BARBARIAN);
+		} else if (walker.type == 0x2d || walker.type == 0x2f) { // enemies
+			colour = colours->index(Caesar3Colours::MAP_SPRITES, Caesar3Colours::SPRITE_ENEMY);
+		} else {
+			// Normal walkers don't show up
+			continue;
 		}
-		delete walkers;
+		getBitmapCoordinates(walker.x, walker.y, mapsize, &coords[0], &coords[1]);
+		img->setIndex(coords[0], coords[1], colour);
+		img->setIndex(coords[0]+1, coords[1], colour);
 	}
-	delete colours;
 	return img;
 }
 
@@ -163,51 +191,51 @@ void C3File::getBuildingColours(unsigned short building, unsigned char edge,
 	if (building >= 0xa00 && building <= 0xb06) {
 		// House
 		if (edge == 64) { // 1-tile house
-			*c1 = colours->colour(Caesar3Colours::MAP_HOUSE, 0);
-			*c2 = colours->colour(Caesar3Colours::MAP_HOUSE, 1);
+			*c1 = colours->index(Caesar3Colours::MAP_HOUSE, 0);
+			*c2 = colours->index(Caesar3Colours::MAP_HOUSE, 1);
 		} else {
 			// left pixel
 			if (edge % 8 == 0 || (edge_below & 0x3f) < edge) { // left edge OR bottom edge
-				*c1 = colours->colour(Caesar3Colours::MAP_HOUSE, 2);
+				*c1 = colours->index(Caesar3Colours::MAP_HOUSE, 2);
 			} else {
-				*c1 = colours->colour(Caesar3Colours::MAP_HOUSE, 0);
+				*c1 = colours->index(Caesar3Colours::MAP_HOUSE, 0);
 			}
 			// right pixel
 			if (edge < 8 || edge_right != (edge & 0x3f) + 1) { // top edge OR right edge
-				*c2 = colours->colour(Caesar3Colours::MAP_HOUSE, 3);
+				*c2 = colours->index(Caesar3Colours::MAP_HOUSE, 3);
 			} else {
-				*c2 = colours->colour(Caesar3Colours::MAP_HOUSE, 1);
+				*c2 = colours->index(Caesar3Colours::MAP_HOUSE, 1);
 			}
 		}
 	} else if (building == 0xb2f) { // reservoir
 		// left pixel
 		if (edge % 8 == 0 || edge > 15) { // left edge OR bottom edge
-			*c1 = colours->colour(Caesar3Colours::MAP_AQUA, 1);
+			*c1 = colours->index(Caesar3Colours::MAP_AQUA, 1);
 		} else {
-			*c1 = colours->colour(Caesar3Colours::MAP_AQUA, 0);
+			*c1 = colours->index(Caesar3Colours::MAP_AQUA, 0);
 		}
 		// right pixel
 		if (edge < 8 || edge % 8 == 2) { // top edge OR right edge
-			*c2 = colours->colour(Caesar3Colours::MAP_AQUA, 1);
+			*c2 = colours->index(Caesar3Colours::MAP_AQUA, 1);
 		} else {
-			*c2 = colours->colour(Caesar3Colours::MAP_AQUA, 0);
+			*c2 = colours->index(Caesar3Colours::MAP_AQUA, 0);
 		}
 	} else { // other building
 		if (edge == 64) { // 1-tile building
-			*c1 = colours->colour(Caesar3Colours::MAP_BUILDING, 0);
-			*c2 = colours->colour(Caesar3Colours::MAP_BUILDING, 1);
+			*c1 = colours->index(Caesar3Colours::MAP_BUILDING, 0);
+			*c2 = colours->index(Caesar3Colours::MAP_BUILDING, 1);
 		} else {
 			// left pixel
 			if (edge % 8 == 0 || (edge & 0x3f) + 8 != edge_below) { // left edge OR bottom edge
-				*c1 = colours->colour(Caesar3Colours::MAP_BUILDING, 0);
+				*c1 = colours->index(Caesar3Colours::MAP_BUILDING, 0);
 			} else {
-				*c1 = colours->colour(Caesar3Colours::MAP_BUILDING, 2);
+				*c1 = colours->index(Caesar3Colours::MAP_BUILDING, 2);
 			}
 			// right pixel
 			if (edge < 8 || edge_right != (edge & 0x3f) + 1) { // top edge OR right edge
-				*c2 = colours->colour(Caesar3Colours::MAP_BUILDING, 1);
+				*c2 = colours->index(Caesar3Colours::MAP_BUILDING, 1);
 			} else {
-				*c2 = colours->colour(Caesar3Colours::MAP_BUILDING, 3);
+				*c2 = colours->index(Caesar3Colours::MAP_BUILDING, 3);
 			}
 		}
 	}
@@ -220,7 +248,7 @@ void C3File::getTerrainColours(unsigned short terrain,
 		unsigned char random, int *c1, int *c2) {
 	// 5 indicates that there is no terrain: beyond map edge
 	if (terrain == 5) {
-		*c1 = *c2 = colours->colour(Caesar3Colours::MAP_BACKGROUND, 0);
+		*c1 = *c2 = colours->index(Caesar3Colours::MAP_BACKGROUND, 0);
 		return;
 	}
 	
@@ -228,111 +256,62 @@ void C3File::getTerrainColours(unsigned short terrain,
 	// the last 2 bits of the random number
 	int num3 = random & 3;
 	if (terrain & 1 || terrain & 16) { // tree/shrub
-		*c1 = colours->colour(Caesar3Colours::MAP_TREE1, num3);
-		*c2 = colours->colour(Caesar3Colours::MAP_TREE2, num3);
+		*c1 = colours->index(Caesar3Colours::MAP_TREE1, num3);
+		*c2 = colours->index(Caesar3Colours::MAP_TREE2, num3);
 	} else if (terrain & 2 || terrain & 512) { // rock / elevation
-		*c1 = colours->colour(Caesar3Colours::MAP_ROCK1, num3);
-		*c2 = colours->colour(Caesar3Colours::MAP_ROCK2, num3);
+		*c1 = colours->index(Caesar3Colours::MAP_ROCK1, num3);
+		*c2 = colours->index(Caesar3Colours::MAP_ROCK2, num3);
 	} else if (terrain & 4) { // water
-		*c1 = colours->colour(Caesar3Colours::MAP_WATER1, num3);
-		*c2 = colours->colour(Caesar3Colours::MAP_WATER2, num3);
+		*c1 = colours->index(Caesar3Colours::MAP_WATER1, num3);
+		*c2 = colours->index(Caesar3Colours::MAP_WATER2, num3);
 	} else if (terrain & 64) { // road
-		*c1 = colours->colour(Caesar3Colours::MAP_ROAD, 0);
-		*c2 = colours->colour(Caesar3Colours::MAP_ROAD, 1);
+		*c1 = colours->index(Caesar3Colours::MAP_ROAD, 0);
+		*c2 = colours->index(Caesar3Colours::MAP_ROAD, 1);
 	} else if (terrain & 2048) { // fertile
-		*c1 = colours->colour(Caesar3Colours::MAP_FERTILE1, num3);
-		*c2 = colours->colour(Caesar3Colours::MAP_FERTILE2, num3);
+		*c1 = colours->index(Caesar3Colours::MAP_FERTILE1, num3);
+		*c2 = colours->index(Caesar3Colours::MAP_FERTILE2, num3);
 	} else if (terrain & 0x4000) { // wall
-		*c1 = colours->colour(Caesar3Colours::MAP_WALL, 0);
-		*c2 = colours->colour(Caesar3Colours::MAP_WALL, 1);
+		*c1 = colours->index(Caesar3Colours::MAP_WALL, 0);
+		*c2 = colours->index(Caesar3Colours::MAP_WALL, 1);
 	} else { // empty land, this one has 8 variants
-		*c1 = colours->colour(Caesar3Colours::MAP_EMPTY1, random & 7);
-		*c2 = colours->colour(Caesar3Colours::MAP_EMPTY2, random & 7);
+		*c1 = colours->index(Caesar3Colours::MAP_EMPTY1, random & 7);
+		*c2 = colours->index(Caesar3Colours::MAP_EMPTY2, random & 7);
 	}
 }
 
 /**
-* Reads a compressed byte grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on a byte grid in decompressed data
 */
-Grid<unsigned char> *C3File::readCompressedByteGrid() {
-	int length = readIntFromStream();
-	Grid<unsigned char> *g = new Grid<unsigned char>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readByte());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned char> C3File::viewByteGrid(const unsigned char *data) {
+	return GridView<unsigned char>(data, MAX_MAPSIZE, MAX_MAPSIZE);
 }
 
 /**
-* Reads a compressed short grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on an uncompressed byte grid in the file.
 */
-Grid<unsigned short> *C3File::readCompressedShortGrid() {
-	int length = readIntFromStream();
-	Grid<unsigned short> *g = new Grid<unsigned short>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readShort());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned char> C3File::viewByteGrid() {
+	return viewByteGrid(getUncompressedData(MAX_MAPSIZE * MAX_MAPSIZE));
 }
 
 /**
-* Reads an uncompressed byte grid from the stream.
+* Returns a view on a short grid in decompressed data
 */
-Grid<unsigned char> *C3File::readByteGrid() {
-	Grid<unsigned char> *g = new Grid<unsigned char>(MAX_MAPSIZE, MAX_MAPSIZE);
-	char c;
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			in->read(&c, 1);
-			g->set(x, y, (unsigned char)c);
-		}
-	}
-	return g;
+GridView<unsigned short> C3File::viewShortGrid(const unsigned char *data) {
+	return GridView<unsigned short>(data, MAX_MAPSIZE, MAX_MAPSIZE);
 }
 
 /**
-* Reads an uncompressed short grid from the stream.
+* Returns a view on an uncompressed short grid in the file.
 */
-Grid<unsigned short> *C3File::readShortGrid() {
-	Grid<unsigned short> *g = new Grid<unsigned short>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			g->set(x, y, readShort());
-		}
-	}
-	return g;
+GridView<unsigned short> C3File::viewShortGrid() {
+	return viewShortGrid(getUncompressedData(MAX_MAPSIZE * MAX_MAPSIZE * 2));
 }
 
 /**
 * Gets the random data from the saved game, which is buried after
 * a few "useless" compressed chunks.
 */
-Grid<unsigned char> *C3File::getRandomData() {
+GridView<unsigned char> C3File::getRandomData() {
 	// Assume the first 4 chunks of data have been read
 	// The next 4 (useless) compressed parts are stored in the same way
 	for (int i = 0; i < 4; i++) {
@@ -340,14 +319,15 @@ Grid<unsigned char> *C3File::getRandomData() {
 	}
 	
 	// Here be the random data
-	return readByteGrid();
+	return viewByteGrid();
 }
 
 /**
-* Gets the walker info from the saved game, which is buried after
+* Queues the walker info from the saved game, which is buried after
 * a few "useless" compressed chunks.
+* @return int Index of the walker chunk in `chunks'
 */
-Walker * C3File::getWalkers() {
+int C3File::queueWalkers(ChunkDecoder *chunks) {
 	// Assume random data has been read already
 	// Which is followed by some more compressed data blocks
 	for (int i = 0; i < 5; i++) {
@@ -355,26 +335,24 @@ Walker * C3File::getWalkers() {
 	}
 	
 	// Next come the walkers in compressed format
-	Walker *walkers = new Walker[MAX_WALKERS];
-	int length = readIntFromStream();
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		// Walker entries are 128 bytes
-		for (int i = 0; i < MAX_WALKERS; i++) {
-			pk.skip(10);
-			walkers[i].type = pk.readShort();
-			pk.skip(8);
-			walkers[i].x = pk.readByte();
-			walkers[i].y = pk.readByte();
-			pk.skip(106);
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete walkers;
-		throw;
+	return queueCompressed(chunks, MAX_WALKERS * 128);
+}
+
+/**
+* Reads the walker info from the decompressed walker table
+*/
+void C3File::readWalkers(const unsigned char *data, WalkerTable *walkers) {
+	walkers->resize(MAX_WALKERS);
+	
+	// Walker entries are 128 bytes
+	const unsigned char *p = data;
+	for (int i = 0; i < MAX_WALKERS; i++) {
+		Walker &walker = (*walkers)[i];
+		walker.type = p[10] | (p[11] << 8);
+		walker.x = p[20];
+		walker.y = p[21];
+		p += 128;
 	}
-	return walkers;
 }
 
 /**
@@ -430,6 +408,51 @@ void C3File::skipCompressed() {
 	in->seekg(skip, ios::cur);
 }
 
+/**
+* Queues the compressed data block at the current position for
+* decompression. Compressed chunks consist of a length followed by a
+* compressed chunk of that length
+* @param size Length of the decompressed data
+* @return int Index of the chunk in `chunks'
+*/
+int C3File::queueCompressed(ChunkDecoder *chunks, int size) {
+	int length = readIntFromStream();
+	const unsigned char *chunk = getCompressedData(&length);
+	return chunks->add(chunk, length, size);
+}
+
+/**
+* Returns the compressed data block at the current position straight
+* from the mapped file, and moves the stream past it
+* @param length Length of the block. Shortened if the file ends early
+*/
+const unsigned char *C3File::getCompressedData(int *length) {
+	int offset = in->tellg();
+	if (offset < 0 || offset > file->size()) {
+		offset = file->size();
+	}
+	if (*length < 0 || *length > file->size() - offset) {
+		*length = file->size() - offset;
+	}
+	in->seekg(offset + *length, ios::beg);
+	return file->data() + offset;
+}
+
+/**
+* Returns the uncompressed data at the current position straight from
+* the mapped file, and moves the stream past it
+* @param length Number of bytes needed
+* @throws const char* if the file ends before that
+*/
+const unsigned char *C3File::getUncompressedData(int length) {
+	int offset = in->tellg();
+	if (offset < 0 || length > file->size() - offset) {
+		throw "Unexpected end of file";
+	}
+	in->seekg(offset + length, ios::beg);
+	return file->data() + offset;
+}
+
 /**
 * Reads an integer from the stream
 */
@@ -444,15 +467,6 @@ int C3File::readIntFromStream() {
 	return number;
 }
 
-/**
-* Reads a short from the stream
-*/
-unsigned short C3File::readShort() {
-	char data[2];
-	in->read(data, 2);
-	return (unsigned short)(data[0] + (data[1] << 8));
-}
-
 /**
 * Returns the bitmap coordinates for a given map coordinate
 */
@@ -462,19 +476,29 @@ void C3File::getBitmapCoordinates(int x, int y, int mapsize, int *x_out, int *y_
 }
 
 int main(int argc, char **argv) {
-	if (argc != 3) {
-		cerr << "Usage: " << argv[0] << " [caesar 3 file] [png output file]" << endl;
+	// Optional compression preset before the file names
+	PNGCompression compression = PNGWriter::BALANCED;
+	int arg = 1;
+	if (argc == 5 && string(argv[1]) == "-c") {
+		if (!PNGWriter::preset(argv[2], &compression)) {
+			cerr << "Unknown compression preset: " << argv[2] << endl;
+			return 1;
+		}
+		arg = 3;
+	}
+	if (argc - arg != 2) {
+		cerr << "Usage: " << argv[0] << " [-c fast|balanced|smallest] [caesar 3 file] [png output file]" << endl;
 		return 1;
 	}
 	try {
-		C3File *cf = new C3File(string(argv[1]));
-		PNGImage *img = cf->getImage();
+		Arena arena;
+		C3File cf(argv[arg], &arena);
+		unique_ptr<IndexedPNGImage> img = cf.getImage();
 		
 		if (img) {
-			img->write(argv[2]);
-			delete img;
+			img->setCompression(compression);
+			img->write(argv[arg + 1]);
 		}
-		delete cf;
 	} catch (...) {
 		cerr << "Couldn't process file. Make sure it's a valid C3 file." << endl;
 		return 2;
@@ -19,21 +19,16 @@
 #ifndef c3file_h
 #define c3file_h
 
-#include "pngimage.h"
-#include "grid.h"
+#include "indexedpngimage.h"
+#include "mapmodel.h"
+#include "mappedfile.h"
+#include "chunkdecoder.h"
 #include "caesar3colours.h"
 #include <string>
 #include <iostream>
-
-/**
-* Walker - stores just the information from the walker table inside
-* the saved games to draw the walkers on the minimap.
-*/
-typedef struct {
-	unsigned short type;
-	unsigned char x;
-	unsigned char y;
-} Walker;
+#include <fstream>
+#include <memory>
+#include <vector>
 
 /**
 * Loads a Caesar 3 .sav or .map file and extracts the minimap.
@@ -43,34 +38,48 @@ class C3File {
 		/**
 		* Constructor. Opens `filename' for parsing. `filename' should exist
 		* @param filename Name of the file to open
+		* @param arena Arena to take the model and image from, or NULL to
+		* use the heap
 		*/
-		C3File(std::string filename);
-		~C3File();
+		C3File(std::string filename, Arena *arena = NULL);
 		
 		/**
 		* Parses the file and returns the minimap image as PNG image
 		* @throws exception if the file is invalid
 		*/
-		PNGImage *getImage();
+		std::unique_ptr<IndexedPNGImage> getImage();
+		
+		/**
+		* Parses the file into a MapModel.
+		* @return MapModel* the map, or NULL if the file couldn't be opened
+		* @throws exception if the file is invalid
+		*/
+		std::unique_ptr<MapModel> getModel();
 	
 	private:
+		std::unique_ptr<IndexedPNGImage> drawModel(const MapModel *model);
 		void getBuildingColours(unsigned short building, unsigned char edge,
 			unsigned char edge_right, unsigned char edge_below, int *c1, int *c2);
 		void getTerrainColours(unsigned short terrain, unsigned char random, int *c1, int *c2);
-		Grid<unsigned char> *readCompressedByteGrid();
-		Grid<unsigned short> *readCompressedShortGrid();
-		Grid<unsigned char> *readByteGrid();
-		Grid<unsigned short> *readShortGrid();
-		Grid<unsigned char> *getRandomData();
-		Walker *getWalkers();
+		GridView<unsigned char> viewByteGrid(const unsigned char *data);
+		GridView<unsigned char> viewByteGrid();
+		GridView<unsigned short> viewShortGrid(const unsigned char *data);
+		GridView<unsigned short> viewShortGrid();
+		GridView<unsigned char> getRandomData();
+		int queueWalkers(ChunkDecoder *chunks);
+		void readWalkers(const unsigned char *data, WalkerTable *walkers);
 		void getMapsizeAndClimate(int *mapsize, int *climate);
 		void skipCompressed();
+		int queueCompressed(ChunkDecoder *chunks, int size);
+		const unsigned char *getCompressedData(int *length);
+		const unsigned char *getUncompressedData(int length);
 		int readIntFromStream();
-		unsigned short readShort();
 		void getBitmapCoordinates(int x, int y, int mapsize, int *x_out, int *y_out);
 		
-		std::ifstream *in;
-		Caesar3Colours *colours;
+		std::unique_ptr<std::ifstream> in;
+		std::unique_ptr<MappedFile> file;
+		std::unique_ptr<Caesar3Colours> colours;
+		Arena *arena;
 		static const int
 			MAX_MAPSIZE = 162,
 			MAX_WALKERS = 1000;
@@ -0,0 +1,100 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "chunkdecoder.h"
+#include <thread>
+
+using namespace std;
+
+ChunkDecoder::ChunkDecoder(int threads, Arena *arena)
+	: chunks(ArenaAllocator<Chunk>(arena)),
+	output(ArenaAllocator<unsigned char>(arena)) {
+	if (threads <= 0) {
+		threads = thread::hardware_concurrency();
+		if (threads <= 0) {
+			threads = 1;
+		}
+	}
+	this->threads = threads;
+	total = 0;
+}
+
+int ChunkDecoder::add(const unsigned char *src, int length, int size) {
+	Chunk c;
+	c.src = src;
+	c.length = length;
+	c.size = size;
+	c.offset = total;
+	c.written = 0;
+	c.status = PK_OK;
+	total += size;
+	chunks.push_back(c);
+	return chunks.size() - 1;
+}
+
+bool ChunkDecoder::run() {
+	output.assign(total, 0);
+	atomic<int> next(0);
+	int count = (threads < (int)chunks.size()) ? threads : chunks.size();
+	
+	// The calling thread decodes chunks as well
+	vector<thread> pool;
+	for (int i = 1; i < count; i++) {
+		pool.push_back(thread(work, this, &next));
+	}
+	work(this, &next);
+	for (unsigned int i = 0; i < pool.size(); i++) {
+		pool[i].join();
+	}
+	
+	for (unsigned int i = 0; i < chunks.size(); i++) {
+		if (chunks[i].status == PK_CORRUPT || chunks[i].status == PK_TRUNCATED ||
+				chunks[i].written < chunks[i].size) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const unsigned char *ChunkDecoder::data(int index) {
+	return output.data() + chunks[index].offset;
+}
+
+PKStatus ChunkDecoder::status(int index) {
+	return chunks[index].status;
+}
+
+int ChunkDecoder::written(int index) {
+	return chunks[index].written;
+}
+
+/**
+* Thread function: keeps decoding the next chunk that hasn't been
+* taken by another thread until all are done. Each thread reuses a
+* single decoder for all of its chunks.
+*/
+void ChunkDecoder::work(ChunkDecoder *decoder, atomic<int> *next) {
+	PKWareInputStream pk;
+	int count = decoder->chunks.size();
+	int index;
+	while ((index = (*next)++) < count) {
+		Chunk *c = &decoder->chunks[index];
+		pk.reset(c->src, c->length);
+		c->status = pk.decompress(decoder->output.data() + c->offset, c->size, &c->written);
+	}
+}
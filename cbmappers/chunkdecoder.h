@@ -0,0 +1,96 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef chunkdecoder_h
+#define chunkdecoder_h
+
+#include "pkwareinputstream.h"
+#include "arena.h"
+#include <vector>
+#include <atomic>
+
+/**
+* Decompresses a batch of independent PKWare chunks at the same time.
+* Chunks are queued with add() while walking through the file, and are
+* all decompressed by run() using a small pool of threads.
+*/
+class ChunkDecoder {
+	public:
+		/**
+		* Constructor
+		* @param threads Maximum number of threads to use, including the
+		* calling one. 0 means one per processor core.
+		* @param arena Arena for the decompressed data, or NULL to use the
+		* heap. It must not be reset while the data is in use.
+		*/
+		ChunkDecoder(int threads = 0, Arena *arena = NULL);
+		
+		/**
+		* Queues a chunk for decompression
+		* @param src Compressed data, including the 2-byte header. Must stay
+		* valid until run() has finished
+		* @param length Length of the compressed data
+		* @param size Length of the decompressed data
+		* @return int Index of the chunk, for use with data() and status()
+		*/
+		int add(const unsigned char *src, int length, int size);
+		
+		/**
+		* Decompresses all queued chunks, returning once all are done
+		* @return bool Whether all chunks could be decompressed to their
+		* full size. A chunk that is corrupt, truncated or ends before its
+		* size is reached counts as a failure.
+		*/
+		bool run();
+		
+		/**
+		* Returns the decompressed data of chunk `index'. If the chunk
+		* ended early, the rest of the data is zero: check run() or
+		* written() before using it.
+		*/
+		const unsigned char *data(int index);
+		
+		/**
+		* Returns the result of decompressing chunk `index'
+		*/
+		PKStatus status(int index);
+		
+		/**
+		* Returns the number of bytes decompressed for chunk `index'
+		*/
+		int written(int index);
+	
+	private:
+		typedef struct {
+			const unsigned char *src;
+			int length;
+			int size;
+			int offset; // in `output'
+			int written; // bytes actually decompressed
+			PKStatus status;
+		} Chunk;
+		
+		static void work(ChunkDecoder *decoder, std::atomic<int> *next);
+		
+		std::vector<Chunk, ArenaAllocator<Chunk> > chunks;
+		std::vector<unsigned char, ArenaAllocator<unsigned char> > output; // for all chunks, allocated by run()
+		int total; // sum of chunk sizes
+		int threads;
+};
+
+#endif /* chunkdecoder_h */
@@ -0,0 +1,93 @@
+/*
+ *   ZeusMapper - create minimaps from Zeus scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef gridview_h
+#define gridview_h
+
+#include <stddef.h>
+
+/**
+* Read-only grid on top of bytes owned by someone else, like a mapped
+* file or a decompressed chunk. The grid is stored as little endian
+* values of sizeof(T) bytes, row after row, as in the game files.
+* Nothing is copied, so the bytes must stay around as long as the view.
+*/
+template <class T>
+class GridView {
+	public:
+		/**
+		* Constructs an empty view; get() returns 0 everywhere
+		*/
+		GridView() {
+			data = NULL;
+			x = y = 0;
+		}
+		
+		/**
+		* Constructs a view of size x by y on `data'
+		* @param data Start of the grid, x * y * sizeof(T) bytes
+		* @param x width of the grid
+		* @param y height of the grid
+		*/
+		GridView(const unsigned char *data, int x, int y) {
+			this->data = data;
+			this->x = x;
+			this->y = y;
+		}
+		
+		/**
+		* Returns the value at (x, y), or 0 outside the grid
+		* @param x X position
+		* @param y Y position
+		* @return T item at position (x, y)
+		*/
+		T get(int x, int y) const {
+			if (x < 0 || y < 0 || x >= this->x || y >= this->y) {
+				return (T)0;
+			}
+			return (*this)(x, y);
+		}
+		
+		/**
+		* Returns the value at (x, y) without any checks
+		*/
+		T operator()(int x, int y) const {
+			const unsigned char *p = data + (y * this->x + x) * sizeof(T);
+			// Written out per size so the compiler turns it into one load
+			if (sizeof(T) == 1) {
+				return (T)p[0];
+			} else if (sizeof(T) == 2) {
+				return (T)(p[0] | (p[1] << 8));
+			}
+			return (T)(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24));
+		}
+		
+		/**
+		* Whether the view points to any data
+		*/
+		bool empty() const { return data == NULL; }
+		
+		int width() const { return x; }
+		int height() const { return y; }
+		
+	private:
+		const unsigned char *data;
+		int x, y;
+};
+
+#endif /* gridview_h */
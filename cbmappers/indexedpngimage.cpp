@@ -1,132 +1,75 @@
-#include "pngimage.h"
-#include <png.h>
-#include <iostream>
-//#include <map>
+#include "indexedpngimage.h"
+#include <cstring>
 using namespace std;
 
-/*
-class Colour {
-	public:
-	png_color p;
-	
-	Colour() {
-		
-	}
-	
-	Colour(int r, int g, int b) {
-		p.red = (unsigned char) r;
-		p.green = (unsigned char) g;
-		p.blue = (unsigned char) b;
-	}
-	
-	Colour& operator=(const Colour& c2) {
-		p.red = c2.p.red;
-		p.green = c2.p.green;
-		p.blue = c2.p.blue;
-		return *this;
+IndexedPNGImage::IndexedPNGImage(int width, int height, const int *palette,
+		int num_colours, Arena *arena)
+	: image(ArenaAllocator<unsigned char>(arena)) {
+	this->arena = arena;
+	init(width, height);
+	if (num_colours <= 0 || num_colours > MAX_COLOURS) {
+		throw "Invalid number of colours";
 	}
-	
-	bool operator==(const Colour& c2) const {
-		return p.red == c2.p.red && p.green == c2.p.green 
-			&& p.blue == c2.p.blue;
-	}
-};
-*/
+	memcpy(this->palette, palette, num_colours * sizeof(int));
+	this->num_colours = num_colours;
+}
 
-PNGImage::PNGImage(int width, int height, int bitdepth) {
+IndexedPNGImage::IndexedPNGImage(int width, int height, Arena *arena)
+	: image(ArenaAllocator<unsigned char>(arena)) {
+	this->arena = arena;
+	init(width, height);
+}
+
+void IndexedPNGImage::init(int width, int height) {
 	if (height <= 0 || width <= 0) {
 		throw "Invalid size";
 	}
 	this->width = width;
 	this->height = height;
-	this->bitdepth = bitdepth;
-	if (bitdepth != 8) {
-		throw "Unsupported bitdepth";
-	}
-	image = new int*[height];
-	for (int i = 0; i < height; i++) {
-		image[i] = new int[width * sizeof(int)];
-		memset(image[i], 0, width * sizeof(int));
-	}
-	colours.insert(0);
+	memset(palette, 0, sizeof(palette));
+	num_colours = 0;
+	compression = PNGWriter::BALANCED;
+	image.assign(width * height, 0);
 }
 
-PNGImage::~PNGImage() {
-	for (int i = 0; i < height; i++) {
-		delete image[i];
+bool IndexedPNGImage::write(std::string filename) {
+	// Leave out the colours that aren't used, keeping the order
+	bool used[MAX_COLOURS];
+	memset(used, 0, sizeof(used));
+	for (int i = 0; i < width * height; i++) {
+		used[image[i]] = true;
 	}
-	delete image;
-}
-
-void PNGImage::setRGB(int x, int y, int color) {
-	if (x < 0 || x >= width || y < 0 || y >= height) {
-		return;
+	unsigned char remap[MAX_COLOURS];
+	int pal[MAX_COLOURS];
+	int num_used = 0;
+	bool same = true;
+	for (int i = 0; i < MAX_COLOURS; i++) {
+		if (used[i]) {
+			remap[i] = num_used;
+			same = same && (i == num_used);
+			pal[num_used++] = palette[i];
+		}
 	}
 	
-	colours.insert(color);
-	image[y][x] = color;
-}
-
-void PNGImage::setRGB(int x, int y, int r, int g, int b) {
-	
-	setRGB(x, y, (r << 16) | (g << 8) | b);
-	
-	return;
-}
-
-bool PNGImage::write(std::string filename) {
-	FILE *fp;
-	png_structp png_ptr;
-	png_infop info_ptr;
-	
-	fp = fopen(filename.c_str(), "wb");
-	if (fp == NULL) {
-		std::cerr << "PNGImage::write: fopen() returned NULL" << std::endl;
+	PNGWriter out(arena);
+	if (!out.open(filename, width, height, pal, num_used, compression)) {
 		return false;
 	}
-	
-	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	info_ptr = png_create_info_struct(png_ptr);
-	png_init_io(png_ptr, fp);
-	png_set_compression_level(png_ptr, 6); // 6 == default compression
-	
-	png_set_IHDR(png_ptr, info_ptr, this->width, this->height,
-		this->bitdepth, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
-		PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-	
-	// Fix up palette
-	int num_colours = colours.size();
-	png_color pal[num_colours];
-	map<int, int> index;
-	set<int>::iterator si;
-	
-	int i = 0;
-	for (si = colours.begin(); si != colours.end(); si++) {
-		index[*si] = i;
-		pal[i].red = *si >> 16;
-		pal[i].green = (*si >> 8) & 0xff;
-		pal[i].blue = *si & 0xff;
-		i++;
-	}
-	png_bytepp data = new png_bytep[height];
+	// Rows go out as they are unless indices moved, in which case
+	// they're renumbered one at a time
+	ArenaAllocator<unsigned char> alloc(arena);
+	vector<unsigned char, ArenaAllocator<unsigned char> > row(width, 0, alloc);
 	for (int y = 0; y < height; y++) {
-		data[y] = new png_byte[width];
-		for (int x = 0; x < width; x++) {
-			data[y][x] = (unsigned char) (index[image[y][x]]);
+		const unsigned char *src = &image[y * width];
+		if (!same) {
+			for (int x = 0; x < width; x++) {
+				row[x] = remap[src[x]];
+			}
+			src = &row[0];
+		}
+		if (!out.writeRow(src)) {
+			return false;
 		}
 	}
-	png_set_PLTE(png_ptr, info_ptr, pal, num_colours);
-	
-	png_write_info(png_ptr, info_ptr);
-	png_write_image(png_ptr, data);
-	png_write_end(png_ptr, info_ptr);
-	png_destroy_write_struct(&png_ptr, &info_ptr);
-	fclose(fp);
-	
-	for (int y = 0; y < height; y++) {
-		delete data[y];
-	}
-	delete data;
-	
-	return true;
+	return out.close();
 }
@@ -1,22 +1,88 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
 #ifndef indexedpngimage_h
 #define indexedpngimage_h
 
 #include <string>
-#include <set>
+#include <vector>
+#include "arena.h"
+#include "pngwriter.h"
 
+/**
+* Palette image. The palette is fixed when the image is created and
+* pixels are set as indices into it, so each pixel takes one byte and
+* nothing needs to be looked up when the image is written. Only the
+* colours that are used end up in the file, which is written with as
+* few bits per pixel as they allow.
+*/
 class IndexedPNGImage {
 	public:
-		IndexedPNGImage(int width, int height, int bitdepth = 8);
-		~IndexedPNGImage();
-		void setRGB(int x, int y, int color);
-		void setRGB(int x, int y, int r, int g, int b);
+		static const int MAX_COLOURS = 256;
+		
+		/**
+		* Constructor. All pixels start out as index 0.
+		* @param palette Colours as 0xRRGGBB; copied
+		* @param num_colours Number of colours in palette, at most MAX_COLOURS
+		* @param arena Arena for the pixels and the buffers of write(),
+		* or NULL to use the heap
+		*/
+		IndexedPNGImage(int width, int height, const int *palette,
+			int num_colours, Arena *arena = NULL);
+		
+		/**
+		* Sets pixel (x, y) to colour `index' of the palette. Positions
+		* outside the image are ignored.
+		*/
+		void setIndex(int x, int y, int index) {
+			if (x < 0 || x >= width || y < 0 || y >= height) {
+				return;
+			}
+			image[y * width + x] = index;
+		}
+		
+		/**
+		* Sets how write() compresses the image; the default is
+		* PNGWriter::BALANCED
+		*/
+		void setCompression(const PNGCompression &compression) {
+			this->compression = compression;
+		}
+		
 		bool write(std::string filename);
-	private:
+	
+	protected:
+		/**
+		* Constructor for subclasses that fill in the palette themselves
+		*/
+		IndexedPNGImage(int width, int height, Arena *arena);
+		
 		int width;
 		int height;
-		int bitdepth;
-		int **image;
-		std::set<int> colours;
+		// Palette index of each pixel, row after row
+		std::vector<unsigned char, ArenaAllocator<unsigned char> > image;
+		int palette[MAX_COLOURS]; // unused entries are black
+		int num_colours;
+		PNGCompression compression;
+		Arena *arena;
+	
+	private:
+		void init(int width, int height);
 };
 
-#endif /* pngimage_h */
+#endif /* indexedpngimage_h */
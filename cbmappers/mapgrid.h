@@ -0,0 +1,257 @@
+/*
+ *   ZeusMapper - create minimaps from Zeus scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef mapgrid_h
+#define mapgrid_h
+
+#include "arena.h"
+#include <memory>
+
+/**
+* Shape of the map inside the full grid
+*/
+enum MapShape {
+	MAP_SQUARE,  // Caesar 3
+	MAP_DIAMOND  // Pharaoh, Zeus
+};
+
+/**
+* Grid that only stores the tiles that are part of the map, plus a
+* margin of MARGIN tiles around it. Caesar 3 maps are a square in the
+* middle of the grid; Pharaoh and Zeus maps are a diamond, which takes
+* up half the tiles of the square around it. Each row of the map is
+* stored after the previous one without gaps, and a table of row
+* offsets keeps finding a tile O(1).
+* The margin holds what the file has just outside the map, so looking
+* at the neighbours of a tile on the edge gives the same as it does on
+* the full grid. Further out, get() returns 0.
+*/
+template <class T>
+class MapGrid {
+	public:
+		/**
+		* Constructs a new grid filled with zeroes
+		* @param size    width and height of the full grid
+		* @param mapsize width and height of the map inside it
+		* @param shape   shape of the map
+		* @param arena   arena to take the memory from, or NULL to use new
+		*/
+		MapGrid(int size, int mapsize, MapShape shape, Arena *arena = NULL) {
+			this->size = size;
+			this->arena = arena;
+			rows = allocate<Row>(size, &own_rows);
+			
+			// Same bounds as the render loops use
+			int half = size / 2;
+			int border = (size - mapsize) / 2;
+			int max = border + mapsize;
+			for (int y = 0; y < size; y++) {
+				Row &r = rows[y];
+				if (y < border || y >= max) {
+					r.first = r.last = 0;
+				} else if (shape == MAP_SQUARE) {
+					r.first = border;
+					r.last  = max;
+				} else {
+					r.first = (y < half) ? (border + half - y - 1) : (border + y - half);
+					r.last  = (y < half) ? (half + y + 1 - border) : (3*half - y - border);
+					if (r.last < r.first) {
+						r.last = r.first;
+					}
+				}
+			}
+			
+			// The margin of a row covers everything within MARGIN tiles
+			// of the map on the rows around it
+			count = 0;
+			stored = 0;
+			for (int y = 0; y < size; y++) {
+				Row &r = rows[y];
+				r.low = size;
+				r.high = 0;
+				for (int n = y - MARGIN; n <= y + MARGIN; n++) {
+					if (n >= 0 && n < size && rows[n].first < rows[n].last) {
+						if (rows[n].first - MARGIN < r.low) r.low = rows[n].first - MARGIN;
+						if (rows[n].last + MARGIN > r.high) r.high = rows[n].last + MARGIN;
+					}
+				}
+				if (r.low < 0) r.low = 0;
+				if (r.high > size) r.high = size;
+				if (r.high < r.low) {
+					r.low = r.high = 0;
+				}
+				r.base = stored - r.low;
+				r.number = count - r.first;
+				stored += r.high - r.low;
+				count += r.last - r.first;
+			}
+			data = allocate<T>(stored, &own_data);
+			fill((T)0);
+		}
+		
+		/**
+		* Sets the value of (x, y) to item. Positions that aren't
+		* stored, neither on the map nor in its margin, are ignored.
+		* @param x X position
+		* @param y Y position
+		* @param item Item to put on (x, y)
+		*/
+		void set(int x, int y, T item) {
+			if (stores(x, y)) {
+				data[rows[y].base + x] = item;
+			}
+		}
+		
+		/**
+		* Returns the value at (x, y), or 0 if it isn't stored
+		* @param x X position
+		* @param y Y position
+		* @return T item at position (x, y)
+		*/
+		T get(int x, int y) const {
+			if (!stores(x, y)) {
+				return (T)0;
+			}
+			return data[rows[y].base + x];
+		}
+		
+		/**
+		* Returns a reference to (x, y) without any checks; (x, y)
+		* must be part of the map or its margin
+		*/
+		T &operator()(int x, int y) {
+			return data[rows[y].base + x];
+		}
+		
+		const T &operator()(int x, int y) const {
+			return data[rows[y].base + x];
+		}
+		
+		/**
+		* Returns the position of (x, y) among the tiles of the map,
+		* which are numbered row by row, leaving out the margin; (x, y)
+		* must be part of the map
+		*/
+		int index(int x, int y) const {
+			return rows[y].number + x;
+		}
+		
+		/**
+		* Whether (x, y) is part of the map
+		*/
+		bool contains(int x, int y) const {
+			return y >= 0 && y < size && x >= rows[y].first && x < rows[y].last;
+		}
+		
+		/**
+		* Returns the first X position of the map on row y
+		*/
+		int begin(int y) const { return rows[y].first; }
+		
+		/**
+		* Returns the X position just past the map on row y
+		*/
+		int end(int y) const { return rows[y].last; }
+		
+		/**
+		* Returns the first X position stored on row y, including the
+		* margin
+		*/
+		int marginBegin(int y) const { return rows[y].low; }
+		
+		/**
+		* Returns the X position just past the margin on row y
+		*/
+		int marginEnd(int y) const { return rows[y].high; }
+		
+		/**
+		* Returns a pointer to the tile (begin(y), y); the rest of the
+		* row follows it
+		*/
+		T *row(int y) { return data + rows[y].base + rows[y].first; }
+		const T *row(int y) const { return data + rows[y].base + rows[y].first; }
+		
+		/**
+		* Sets every tile of the map and its margin to item
+		* @param item Item to put everywhere
+		*/
+		void fill(T item) {
+			for (int i = 0; i < stored; i++) {
+				data[i] = item;
+			}
+		}
+		
+		int width() const { return size; }
+		int height() const { return size; }
+		
+		/**
+		* Returns the number of tiles of the map, without the margin
+		*/
+		int tiles() const { return count; }
+		
+		// Tiles stored around the map on each side
+		static const int MARGIN = 1;
+		
+	private:
+		/**
+		* Bounds of one row
+		*/
+		typedef struct {
+			int first;  // first X of the map
+			int last;   // X just past the end of the map
+			int low;    // first X stored, with the margin
+			int high;   // X just past the last one stored
+			int base;   // offset of (0, y) in data; may point outside data
+			int number; // index() of (0, y); may be negative
+		} Row;
+		
+		// Copying would free the memory twice
+		MapGrid(const MapGrid &);
+		MapGrid &operator=(const MapGrid &);
+		
+		/**
+		* Whether (x, y) is stored
+		*/
+		bool stores(int x, int y) const {
+			return y >= 0 && y < size && x >= rows[y].low && x < rows[y].high;
+		}
+		
+		/**
+		* Takes memory for `n' items from the arena, or from new if there
+		* is none; `owner' then frees it again
+		*/
+		template <class U>
+		U *allocate(int n, std::unique_ptr<U[]> *owner) {
+			if (arena) {
+				return (U *)arena->allocate(n * sizeof(U));
+			}
+			owner->reset(new U[n]);
+			return owner->get();
+		}
+		
+		Arena *arena;
+		int size;
+		int count;  // tiles of the map
+		int stored; // tiles of the map and its margin
+		Row *rows;
+		T *data;
+		std::unique_ptr<Row[]> own_rows; // unless from the arena
+		std::unique_ptr<T[]> own_data;   // unless from the arena
+};
+
+#endif /* mapgrid_h */
@@ -0,0 +1,32 @@
+/*
+ *   ZeusMapper - create minimaps from Zeus scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "mapmodel.h"
+
+MapModel::MapModel(int size, int mapsize, MapShape shape, Arena *arena)
+	: terrain(size, mapsize, shape, arena), building_grid(size, mapsize, shape, arena),
+	edges(size, mapsize, shape, arena), random(size, mapsize, shape, arena),
+	meadow(size, mapsize, shape, arena), scrub(size, mapsize, shape, arena),
+	marble(size, mapsize, shape, arena),
+	walkers(ArenaAllocator<Walker>(arena)),
+	buildings(ArenaAllocator<Building>(arena)) {
+	this->size = size;
+	this->mapsize = mapsize;
+	climate = 0;
+	expansion = false;
+}
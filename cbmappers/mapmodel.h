@@ -0,0 +1,111 @@
+/*
+ *   ZeusMapper - create minimaps from Zeus scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef mapmodel_h
+#define mapmodel_h
+
+#include "mapgrid.h"
+#include "gridview.h"
+#include "arena.h"
+#include <vector>
+
+/**
+* Walker - stores just the information from the walker table inside
+* the saved games to draw the walkers on the minimap.
+*/
+typedef struct {
+	unsigned short type;
+	unsigned short x;
+	unsigned short y;
+} Walker;
+
+/**
+* Building - the information from the building table needed to draw
+* the building on the minimap.
+*/
+typedef struct {
+	unsigned short type;
+	unsigned short x;
+	unsigned short y;
+	unsigned char size;
+	unsigned char rotation;
+} Building;
+
+typedef std::vector<Walker, ArenaAllocator<Walker> > WalkerTable;
+typedef std::vector<Building, ArenaAllocator<Building> > BuildingTable;
+
+/**
+* Everything the mappers know about one map, in the same layout for
+* all games. Each layer holds one value for every tile of the map and
+* the tiles right around it, and only for those: a square for Caesar 3
+* and a diamond for Pharaoh and Zeus. Layers a game doesn't have stay 0. The parsers
+* fill it in, after which it can be drawn or exported any number of
+* times without touching the file again.
+*/
+class MapModel {
+	public:
+		/**
+		* Constructs an empty model
+		* @param size    Width and height of the full grid: the maximum
+		* map size of the game
+		* @param mapsize Width and height of the map
+		* @param shape   Shape of the map
+		* @param arena   Arena for the layers and tables, or NULL to use
+		* the heap. It must not be reset while the model exists.
+		*/
+		MapModel(int size, int mapsize, MapShape shape, Arena *arena = NULL);
+		
+		/**
+		* Copies a grid from the file into one of the layers, the margin
+		* around the map included
+		* @param layer Layer to fill
+		* @param view  Grid to copy, as stored in the file
+		*/
+		template <class T, class S>
+		static void load(MapGrid<T> *layer, const GridView<S> &view) {
+			if (view.empty()) {
+				return;
+			}
+			for (int y = 0; y < layer->height(); y++) {
+				int end = layer->marginEnd(y);
+				for (int x = layer->marginBegin(y); x < end; x++) {
+					(*layer)(x, y) = (T)view(x, y);
+				}
+			}
+		}
+		
+		// Layers
+		MapGrid<unsigned int> terrain;        // terrain flags
+		MapGrid<unsigned int> building_grid;  // building number on each tile
+		MapGrid<unsigned char> edges;         // position of a tile within its building
+		MapGrid<unsigned char> random;        // picks the terrain variant
+		MapGrid<unsigned char> meadow;        // meadow fertility (Zeus)
+		MapGrid<unsigned char> scrub;         // scrub (Zeus)
+		MapGrid<unsigned char> marble;        // marble; 255 if unknown (Zeus)
+		
+		// Entities; only saved games have these
+		WalkerTable walkers;
+		BuildingTable buildings; // unused slots left out
+		
+		int size;       // width and height of the full grid
+		int mapsize;    // width and height of the playable map
+		int climate;    // climate (Caesar 3)
+		bool expansion; // whether the map is from the expansion (Poseidon)
+};
+
+#endif /* mapmodel_h */
@@ -0,0 +1,75 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "mappedfile.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+MappedFile::MappedFile(string filename) {
+	contents = NULL;
+	length = 0;
+	mapped = false;
+	
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw "Can't read file";
+	}
+	struct stat info;
+	if (fstat(fd, &info) == -1) {
+		close(fd);
+		throw "Can't read file";
+	}
+	length = (int)info.st_size;
+	if (length == 0) {
+		close(fd);
+		return;
+	}
+	
+	void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map != MAP_FAILED) {
+		contents = (unsigned char *)map;
+		mapped = true;
+		close(fd);
+		return;
+	}
+	
+	// Can't map this file, read it instead
+	contents = new unsigned char[length];
+	int done = 0;
+	while (done < length) {
+		ssize_t count = ::read(fd, contents + done, length - done);
+		if (count <= 0) {
+			break;
+		}
+		done += count;
+	}
+	close(fd);
+	length = done;
+}
+
+MappedFile::~MappedFile() {
+	if (mapped) {
+		munmap(contents, length);
+	} else {
+		delete[] contents;
+	}
+}
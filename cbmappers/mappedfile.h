@@ -0,0 +1,59 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef mappedfile_h
+#define mappedfile_h
+
+#include <string>
+
+/**
+* Read-only view of a whole file in memory. The file is mapped into
+* memory where possible, so the data is read straight from the page
+* cache; otherwise it is read into a buffer.
+*/
+class MappedFile {
+	public:
+		/**
+		* Constructor. Maps `filename' into memory
+		* @param filename Name of the file to open
+		* @throws const char* if the file can't be read
+		*/
+		MappedFile(std::string filename);
+		~MappedFile();
+		
+		/**
+		* Returns the contents of the file
+		*/
+		const unsigned char *data() const { return contents; }
+		
+		/**
+		* Returns the size of the file in bytes
+		*/
+		int size() const { return length; }
+	
+	private:
+		// Copying would unmap or free the contents twice
+		MappedFile(const MappedFile &);
+		MappedFile &operator=(const MappedFile &);
+		
+		unsigned char *contents;
+		int length;
+		bool mapped;
+};
+
+#endif /* mappedfile_h */
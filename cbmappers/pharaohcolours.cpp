@@ -55,6 +55,28 @@ PharaohColours::PharaohColours() {
 			cmap[i][j] = colours[i][j];
 		}
 	}
+	buildPalette();
+}
+
+/**
+* Collects the distinct colours of the set into palette_table, starting
+* with black, and fills in the index of every colour
+*/
+void PharaohColours::buildPalette() {
+	palette_table[0] = 0x000000;
+	palette_size = 1;
+	for (int i = 0; i < MAP_SIZE; i++) {
+		for (int j = 0; j < 8; j++) {
+			int k = 0;
+			while (k < palette_size && palette_table[k] != cmap[i][j]) {
+				k++;
+			}
+			if (k == palette_size) {
+				palette_table[palette_size++] = cmap[i][j];
+			}
+			indices[i][j] = k;
+		}
+	}
 }
 
 int PharaohColours::colour(int type, int number) {
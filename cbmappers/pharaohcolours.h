@@ -61,10 +61,32 @@ class PharaohColours {
 			SPRITE_ENEMY     = 2;
 	private:
 		int cmap[MAP_SIZE][8];
+		unsigned char indices[MAP_SIZE][8]; // into palette_table
+		int palette_table[MAP_SIZE * 8 + 1];
+		int palette_size;
+		void buildPalette();
 		
 	public:
 		PharaohColours();
 		int colour(int type, int number);
+		
+		/**
+		* Returns the palette index of a colour, for drawing on an
+		* IndexedPNGImage with palette()
+		* @param type - one of the MAP_* constants
+		* @param number - 0-7, or one of the SPRITE_* constants
+		* @return int index into palette()
+		*/
+		int index(int type, int number) {
+			return indices[type][number];
+		}
+		
+		/**
+		* Returns the distinct colours of this set. Index 0 is black,
+		* the colour of pixels that aren't drawn.
+		*/
+		const int *palette() { return palette_table; }
+		int paletteSize() { return palette_size; }
 		int map(int building_id);
 };
 
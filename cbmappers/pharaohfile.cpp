@@ -19,30 +19,38 @@
 #include "pharaohfile.h"
 #include "pkwareinputstream.h"
 #include <fstream>
+#include <string.h>
 
 using namespace std;
 
-PharaohFile::PharaohFile(string filename) {
-	in = new ifstream();
+PharaohFile::PharaohFile(string filename, Arena *arena) {
+	this->arena = arena;
+	in.reset(new ifstream());
 	in->open(filename.c_str(), ios::in | ios::binary);
 	if (!in->is_open()) {
 		throw "Can't read file";
 	}
+	file.reset(new MappedFile(filename));
 }
 
-PharaohFile::~PharaohFile() {
-	delete in;
+unique_ptr<IndexedPNGImage> PharaohFile::getImage() {
+	unique_ptr<MapModel> model = getModel();
+	if (!model) {
+		return NULL;
+	}
+	return drawModel(model.get());
 }
 
-PNGImage *PharaohFile::getImage() {
+unique_ptr<MapModel> PharaohFile::getModel() {
 	if (!in->is_open()) {
 		return NULL;
 	}
 	
-	Grid<unsigned int> *building_grid = NULL, *terrain = NULL;
-	Grid<unsigned char> *edges = NULL, *random = NULL;
-	Walker *walkers = NULL;
-	Building *buildings = NULL;
+	// Holds the decompressed grids; the views point into it
+	ChunkDecoder chunks(0, arena);
+	GridView<unsigned int> building_grid, terrain;
+	GridView<unsigned char> edges, random;
+	int c_walkers = -1, c_buildings = -1;
 	int mapsize;
 	bool is_scenario = false;
 	char fourcc[5];
@@ -54,32 +62,62 @@ PNGImage *PharaohFile::getImage() {
 	if (is_scenario) {
 		// Read scenario info
 		in->seekg(0x177c, ios::beg);
-		building_grid = readIntGrid();
-		edges = readByteGrid();
-		terrain = readIntGrid();
+		building_grid = viewIntGrid();
+		edges = viewByteGrid();
+		terrain = viewIntGrid();
 		in->seekg(51984, ios::cur);
-		random = readByteGrid();
+		random = viewByteGrid();
 		in->seekg(0x99C78, ios::beg);
 		mapsize = readInt();
 	} else {
+		// Compressed chunks are only located while walking through the
+		// file, and decompressed all at once afterwards
 		in->seekg(0x177c, ios::beg);
-		building_grid = readCompressedIntGrid();
-		edges = readCompressedByteGrid();
+		int c_building_grid = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE * 4);
+		int c_edges = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE);
 		skipCompressed(); // building IDs
-		terrain = readCompressedIntGrid();
+		int c_terrain = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE * 4);
 		random = getRandomData();
-		walkers = getWalkers();
-		buildings = getBuildings();
+		c_walkers = queueWalkers(&chunks);
+		c_buildings = queueBuildings(&chunks);
 		mapsize = getMapsize();
+		
+		if (!chunks.run()) {
+			throw PKException("Invalid compressed data");
+		}
+		building_grid = viewIntGrid(chunks.data(c_building_grid));
+		edges = viewByteGrid(chunks.data(c_edges));
+		terrain = viewIntGrid(chunks.data(c_terrain));
 	}
 	
 	if (mapsize > MAX_MAPSIZE) {
 		throw "Invalid map size";
 	}
 	
+	unique_ptr<MapModel> model(new MapModel(MAX_MAPSIZE, mapsize, MAP_DIAMOND, arena));
+	MapModel::load(&model->building_grid, building_grid);
+	MapModel::load(&model->edges, edges);
+	MapModel::load(&model->terrain, terrain);
+	MapModel::load(&model->random, random);
+	if (c_walkers != -1) {
+		readWalkers(chunks.data(c_walkers), &model->walkers);
+	}
+	if (c_buildings != -1) {
+		readBuildings(chunks.data(c_buildings), &model->buildings);
+	}
+	return model;
+}
+
+/**
+* Draws the minimap of a parsed map
+*/
+unique_ptr<IndexedPNGImage> PharaohFile::drawModel(const MapModel *model) {
+	int mapsize = model->mapsize;
+	
 	// Transform it to something useful
-	colours = new PharaohColours(); // all climates have the same minimap colours
-	PNGImage *img = new PNGImage(mapsize, mapsize);
+	colours.reset(new PharaohColours()); // all climates have the same minimap colours
+	unique_ptr<IndexedPNGImage> img(new IndexedPNGImage(mapsize, mapsize,
+		colours->palette(), colours->paletteSize(), arena));
 	int half = MAX_MAPSIZE / 2;
 	int border = (MAX_MAPSIZE - mapsize) / 2;
 	int max = border + mapsize;
@@ -92,61 +130,54 @@ PNGImage *PharaohFile::getImage() {
 	for (int y = border; y < max; y++) {
 		start = (y < half) ? (border + half - y - 1) : (border + y - half);
 		end   = (y < half) ? (half + y + 1 - border) : (3*half - y - border);
+		// Rows of the layers start at x = start
+		const unsigned int *terrain_row = model->terrain.row(y);
+		const unsigned int *building_row = model->building_grid.row(y);
+		const unsigned char *random_row = model->random.row(y);
 		for (int x = start; x < end; x++) {
-			t_terrain  = terrain->get(x, y);
-			t_building = building_grid->get(x, y);
-			t_random = random->get(x, y);
+			t_terrain  = terrain_row[x - start];
+			t_building = building_row[x - start];
+			t_random = random_row[x - start];
 			getTerrainColours(t_terrain, t_random, &c1, &c2);
 			if ((t_terrain & 0x48) == 0x8 && (
 				(t_building >= 0x3dc6 && t_building <= 0x3ed5) ||
 				(t_building >= 0x3720 && t_building <= 0x3739))) {
 				// Temple complex or festival square
-				c1 = colours->colour(PharaohColours::MAP_RELIGION, 0);
-				c2 = colours->colour(PharaohColours::MAP_RELIGION, 1);
+				c1 = colours->index(PharaohColours::MAP_RELIGION, 0);
+				c2 = colours->index(PharaohColours::MAP_RELIGION, 1);
 			}
 			// Set pixel colours
 			getBitmapCoordinates(x-border, y-border, mapsize, &coords[0], &coords[1]);
-			img->setRGB(coords[0], coords[1], c1);
-			img->setRGB(coords[0]+1, coords[1], c2);
+			img->setIndex(coords[0], coords[1], c1);
+			img->setIndex(coords[0]+1, coords[1], c2);
 		}
 	}
 	
-	if (buildings) {
-		placeBuildings(img, buildings, terrain, edges, mapsize);
-		delete buildings;
-	}
-	delete terrain;
-	delete edges;
-	delete random;
-	delete building_grid;
+	placeBuildings(img.get(), model);
 	
-	if (walkers) {
-		// Get walkers
-		int colour;
-		for (int i = 0; i < MAX_WALKERS; i++) {
-			colour = walkers[i].type;
-			if (walkers[i].type == 0xb || walkers[i].type == 0xc || walkers[i].type == 0xd) { // our soldiers
-				colour = colours->colour(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_SOLDIER);
-			} else if (walkers[i].type == 0x14 || walkers[i].type == 0x19 || walkers[i].type == 0x4c // trade ship / fishing boat / ferry
-			|| walkers[i].type == 0x4d || walkers[i].type == 0x4e) { // transport ship / warship
-				colour = colours->colour(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_SHIP);
-			} else if (walkers[i].type == 0x54 || walkers[i].type == 0x68) { // pharaoh or cleo killer animal
-				colour = colours->colour(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_ANIMAL);
-			} else if (walkers[i].type == 0x2b || walkers[i].type == 0x2c || walkers[i].type == 0x2d || // enemy
-				walkers[i].type == 0x36 || walkers[i].type == 0x37 || // egyption invaders
-				walkers[i].type == 0x63) { // bedouins
-				colour = colours->colour(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_ENEMY);
-			} else {
-				continue;
-			}
-			
-			getBitmapCoordinates(walkers[i].x, walkers[i].y, mapsize, &coords[0], &coords[1]);
-			img->setRGB(coords[0], coords[1], colour);
-			img->setRGB(coords[0]+1, coords[1], colour);
+	// Only saved games have walkers
+	int colour;
+	for (unsigned int i = 0; i < model->walkers.size(); i++) {
+		const Walker &walker = model->walkers[i];
+		if (walker.type == 0xb || walker.type == 0xc || walker.type == 0xd) { // our soldiers
+			colour = colours->index(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_SOLDIER);
+		} else if (walker.type == 0x14 || walker.type == 0x19 || walker.type == 0x4c // trade ship / fishing boat / ferry
+		|| walker.type == 0x4d || walker.type == 0x4e) { // transport ship / warship
+			colour = colours->index(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_SHIP);
+		} else if (walker.type == 0x54 || walker.type == 0x68) { // pharaoh or cleo killer animal
+			colour = colours->index(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_ANIMAL);
+		} else if (walker.type == 0x2b || walker.type == 0x2c || walker.type == 0x2d || // enemy
+			walker.type == 0x36 || walker.type == 0x37 || // egyption invaders
+			walker.type == 0x63) { // bedouins
+			colour = colours->index(PharaohColours::MAP_SPRITES, PharaohColours::SPRITE_ENEMY);
+		} else {
+			continue;
 		}
-		delete walkers;
+		
+		getBitmapCoordinates(walker.x, walker.y, mapsize, &coords[0], &coords[1]);
+		img->setIndex(coords[0], coords[1], colour);
+		img->setIndex(coords[0]+1, coords[1], colour);
 	}
-	delete colours;
 	
 	//img->write("out.png");
 	return img;
@@ -155,23 +186,18 @@ PNGImage *PharaohFile::getImage() {
 /**
 * Goes through the list of buildings and places them on the image
 * @param img       Image to write on
-* @param buildings Building list
-* @param terrain   Terrain information
-* @param edges     Edge information
-* @param mapsize   Total size of the image
+* @param model     Map with the buildings, terrain and edges
 */
-void PharaohFile::placeBuildings(PNGImage *img, Building *buildings,
-		Grid<unsigned int> *terrain, Grid<unsigned char> *edges, int mapsize) {
+void PharaohFile::placeBuildings(IndexedPNGImage *img, const MapModel *model) {
 	int cid, num;
-	Building *b;
+	const Building *b;
+	const MapGrid<unsigned int> &terrain = model->terrain;
+	const MapGrid<unsigned char> *edges = &model->edges;
+	int mapsize = model->mapsize;
 	int border = (MAX_MAPSIZE - mapsize) / 2;
-	for (int i = 0; i < MAX_BUILDINGS; i++) {
-		if (buildings[i].type == 0) {
-			// building slot unused
-			continue;
-		}
+	for (unsigned int i = 0; i < model->buildings.size(); i++) {
 		// Shorten access
-		b = &buildings[i];
+		b = &model->buildings[i];
 		
 		num = 0;
 		
@@ -180,7 +206,7 @@ void PharaohFile::placeBuildings(PNGImage *img, Building *buildings,
 			// Unknown building
 			continue;
 		} else if (cid != PharaohColours::MAP_MONUMENTS
-		&& (terrain->get(border + b->x, border + b->y) & 0x8) != 0x8) {
+		&& (terrain.get(border + b->x, border + b->y) & 0x8) != 0x8) {
 			// Building is not a building on the map
 			// Most likely flooded farm
 			continue;
@@ -197,14 +223,14 @@ void PharaohFile::placeBuildings(PNGImage *img, Building *buildings,
 					unsigned char edge_right = edges->get(border+b->x+x+1, border+b->y+y);
 					unsigned char edge_below = edges->get(border+b->x+x, border+b->y+y+1);
 					if (edge % 8 == 0 || (edge_below & 0x3f) < edge) {
-						img->setRGB(coords[0], coords[1], colours->colour(cid, 1));
+						img->setIndex(coords[0], coords[1], colours->index(cid, 1));
 					} else {
-						img->setRGB(coords[0], coords[1], colours->colour(cid, 3));
+						img->setIndex(coords[0], coords[1], colours->index(cid, 3));
 					}
 					if (edge < 8 || edge_right != (edge & 0x3f) + 1) {
-						img->setRGB(coords[0]+1, coords[1], colours->colour(cid, 0));
+						img->setIndex(coords[0]+1, coords[1], colours->index(cid, 0));
 					} else {
-						img->setRGB(coords[0]+1, coords[1], colours->colour(cid, 2));
+						img->setIndex(coords[0]+1, coords[1], colours->index(cid, 2));
 					}
 				}
 			}
@@ -213,7 +239,7 @@ void PharaohFile::placeBuildings(PNGImage *img, Building *buildings,
 			continue;
 		} else if (b->type == 0x2a) { // medium statue: all c1
 			placeBuilding(img, edges, mapsize, b->x, b->y, b->size, b->size,
-					colours->colour(cid, 0), colours->colour(cid, 0));
+					colours->index(cid, 0), colours->index(cid, 0));
 			continue;
 		} else if (b->type == 0x2b) { // large statue
 			int coords[2];
@@ -224,28 +250,28 @@ void PharaohFile::placeBuildings(PNGImage *img, Building *buildings,
 					unsigned char edge_right = edges->get(border+b->x+x+1, border+b->y+y);
 					unsigned char edge_below = edges->get(border+b->x+x, border+b->y+y+1);
 					if (edge % 8 == 0 || (edge_below & 0x3f) < edge) {
-						img->setRGB(coords[0], coords[1], colours->colour(cid, 2));
+						img->setIndex(coords[0], coords[1], colours->index(cid, 2));
 					} else {
-						img->setRGB(coords[0], coords[1], colours->colour(cid, 0));
+						img->setIndex(coords[0], coords[1], colours->index(cid, 0));
 					}
 					if (edge < 8 || edge_right != (edge & 0x3f) + 1) {
-						img->setRGB(coords[0]+1, coords[1], colours->colour(cid, 3));
+						img->setIndex(coords[0]+1, coords[1], colours->index(cid, 3));
 					} else {
-						img->setRGB(coords[0]+1, coords[1], colours->colour(cid, 0));
+						img->setIndex(coords[0]+1, coords[1], colours->index(cid, 0));
 					}
 				}
 			}
 			continue;
 		} else if (b->type == 0xe5 || b->type == 0xea || b->type == 0xeb || b->type == 0xec) { // tombs
 			int coords[2];
-			int c1 = colours->colour(cid, 1);
-			int c2 = colours->colour(cid, 0);
+			int c1 = colours->index(cid, 1);
+			int c2 = colours->index(cid, 0);
 			for (int y = 0; y < b->size; y++) {
 				for (int x = 0; x < b->size; x++) {
-					if (!(terrain->get(border + b->x + x, border + b->y + y) & 0x40000000)) {
+					if (!(terrain.get(border + b->x + x, border + b->y + y) & 0x40000000)) {
 						getBitmapCoordinates(b->x + x, b->y + y, mapsize, &coords[0], &coords[1]);
-						img->setRGB(coords[0], coords[1], c1);
-						img->setRGB(coords[0]+1, coords[1], c2);
+						img->setIndex(coords[0], coords[1], c1);
+						img->setIndex(coords[0]+1, coords[1], c2);
 					}
 				}
 			}
@@ -255,19 +281,19 @@ void PharaohFile::placeBuildings(PNGImage *img, Building *buildings,
 			// the road itself as well
 			if (b->rotation) {
 				placeBuilding(img, edges, mapsize, b->x + 3, b->y, 2, 2,
-					colours->colour(cid, 0), colours->colour(cid, 1));
+					colours->index(cid, 0), colours->index(cid, 1));
 				placeBuilding(img, edges, mapsize, b->x + 2, b->y, 1, 2,
-					colours->colour(cid, 0), colours->colour(cid, 1));
+					colours->index(cid, 0), colours->index(cid, 1));
 			} else {
 				placeBuilding(img, edges, mapsize, b->x, b->y + 3, 2, 2,
-					colours->colour(cid, 0), colours->colour(cid, 1));
+					colours->index(cid, 0), colours->index(cid, 1));
 				placeBuilding(img, edges, mapsize, b->x, b->y + 2, 2, 1,
-					colours->colour(cid, 0), colours->colour(cid, 1));
+					colours->index(cid, 0), colours->index(cid, 1));
 			}
 		}
 		
 		placeBuilding(img, edges, mapsize, b->x, b->y, b->size, b->size,
-			colours->colour(cid, num), colours->colour(cid, num+1));
+			colours->index(cid, num), colours->index(cid, num+1));
 	}
 }
 
@@ -284,13 +310,13 @@ void PharaohFile::placeBuildings(PNGImage *img, Building *buildings,
 * @param c1      Colour 1 -- used for building interior
 * @param c2      Colour 2 -- used for top & right edge
 */
-void PharaohFile::placeBuilding(PNGImage *img, Grid<unsigned char> *edges,
+void PharaohFile::placeBuilding(IndexedPNGImage *img, const MapGrid<unsigned char> *edges,
 		int mapsize, int posX, int posY, int sizeX, int sizeY, int c1, int c2) {
 	int coords[2];
 	if (sizeX == 1 && sizeY == 1) {
 		getBitmapCoordinates(posX, posY, mapsize, &coords[0], &coords[1]);
-		img->setRGB(coords[0], coords[1], c2);
-		img->setRGB(coords[0]+1, coords[1], c1);
+		img->setIndex(coords[0], coords[1], c2);
+		img->setIndex(coords[0]+1, coords[1], c1);
 	} else {
 		int offset = (MAX_MAPSIZE - mapsize) / 2;
 		for (int y = 0; y < sizeY; y++) {
@@ -298,16 +324,16 @@ void PharaohFile::placeBuilding(PNGImage *img, Grid<unsigned char> *edges,
 				getBitmapCoordinates(posX + x, posY + y, mapsize, &coords[0], &coords[1]);
 				unsigned char edge = edges->get(offset+posX+x, offset+posY+y);
 				if (edge == 64) {
-					img->setRGB(coords[0], coords[1], c2);
-					img->setRGB(coords[0]+1, coords[1], c1);
+					img->setIndex(coords[0], coords[1], c2);
+					img->setIndex(coords[0]+1, coords[1], c1);
 				} else { // is not 1-tile building
 					unsigned char edge_right = edges->get(offset+posX+x+1, offset+posY+y);
-					img->setRGB(coords[0], coords[1], c1);
+					img->setIndex(coords[0], coords[1], c1);
 					if (edge < 8 || edge_right != (edge & 0x3f) + 1 // top edge OR right edge
 						|| (sizeX == 6 && x == 2) || (sizeY == 6 && y == 3)) { // 6x6 split
-						img->setRGB(coords[0]+1, coords[1], c2);
+						img->setIndex(coords[0]+1, coords[1], c2);
 					} else {
-						img->setRGB(coords[0]+1, coords[1], c1);
+						img->setIndex(coords[0]+1, coords[1], c1);
 					}
 				}
 			}
@@ -320,181 +346,93 @@ void PharaohFile::placeBuilding(PNGImage *img, Grid<unsigned char> *edges,
 */
 void PharaohFile::getTerrainColours(unsigned int terrain, unsigned char random, int *c1, int *c2) {
 	if (terrain & 0x80000) {
-		*c1 = *c2 = colours->colour(PharaohColours::MAP_BACKGROUND, 0);
+		*c1 = *c2 = colours->index(PharaohColours::MAP_BACKGROUND, 0);
 		return;
 	}
 	
 	int num3 = random & 3;
 	if (terrain & 0x1) { // tree/shrub
-		*c1 = colours->colour(PharaohColours::MAP_TREE1, num3);
-		*c2 = colours->colour(PharaohColours::MAP_TREE2, num3);
+		*c1 = colours->index(PharaohColours::MAP_TREE1, num3);
+		*c2 = colours->index(PharaohColours::MAP_TREE2, num3);
 	} else if (terrain & 0x2) { // rock
-		*c1 = colours->colour(PharaohColours::MAP_ROCK1, num3);
-		*c2 = colours->colour(PharaohColours::MAP_ROCK2, num3);
+		*c1 = colours->index(PharaohColours::MAP_ROCK1, num3);
+		*c2 = colours->index(PharaohColours::MAP_ROCK2, num3);
 	} else if (terrain == 0x44) { // water + bridge = road
-		*c1 = colours->colour(PharaohColours::MAP_ROAD, 0);
-		*c2 = colours->colour(PharaohColours::MAP_ROAD, 1);
+		*c1 = colours->index(PharaohColours::MAP_ROAD, 0);
+		*c2 = colours->index(PharaohColours::MAP_ROAD, 1);
 	} else if (terrain & 0x4) { // water
-		*c1 = colours->colour(PharaohColours::MAP_WATER1, num3);
-		*c2 = colours->colour(PharaohColours::MAP_WATER2, num3);
+		*c1 = colours->index(PharaohColours::MAP_WATER1, num3);
+		*c2 = colours->index(PharaohColours::MAP_WATER2, num3);
 	} else if (terrain & 0x20) { // garden
 		if (terrain & 0x8) { // garden + building = entertainment
-			*c1 = colours->colour(PharaohColours::MAP_ENTERTAINMENT, 1);
-			*c2 = colours->colour(PharaohColours::MAP_ENTERTAINMENT, 0);
+			*c1 = colours->index(PharaohColours::MAP_ENTERTAINMENT, 1);
+			*c2 = colours->index(PharaohColours::MAP_ENTERTAINMENT, 0);
 		} else {
-			*c1 = colours->colour(PharaohColours::MAP_AESTHETICS, 1);
-			*c2 = colours->colour(PharaohColours::MAP_AESTHETICS, 0);
+			*c1 = colours->index(PharaohColours::MAP_AESTHETICS, 1);
+			*c2 = colours->index(PharaohColours::MAP_AESTHETICS, 0);
 		}
 	} else if (terrain & 0x40) { // road
-		*c1 = colours->colour(PharaohColours::MAP_ROAD, 0);
-		*c2 = colours->colour(PharaohColours::MAP_ROAD, 1);
+		*c1 = colours->index(PharaohColours::MAP_ROAD, 0);
+		*c2 = colours->index(PharaohColours::MAP_ROAD, 1);
 	} else if (terrain & 0x100) { // irrigation
-		*c1 = colours->colour(PharaohColours::MAP_WATER1, 4);
-		*c2 = colours->colour(PharaohColours::MAP_WATER2, 4);
+		*c1 = colours->index(PharaohColours::MAP_WATER1, 4);
+		*c2 = colours->index(PharaohColours::MAP_WATER2, 4);
 	} else if (terrain & 0x800 || terrain & 0x10000) { // meadow or floodplain
-		*c1 = colours->colour(PharaohColours::MAP_FERTILE1, num3);
-		*c2 = colours->colour(PharaohColours::MAP_FERTILE2, num3);
+		*c1 = colours->index(PharaohColours::MAP_FERTILE1, num3);
+		*c2 = colours->index(PharaohColours::MAP_FERTILE2, num3);
 	} else if (terrain & 0x2000000) { // sand dune
-		*c1 = colours->colour(PharaohColours::MAP_DUNE1, num3);
-		*c2 = colours->colour(PharaohColours::MAP_DUNE2, num3);
+		*c1 = colours->index(PharaohColours::MAP_DUNE1, num3);
+		*c2 = colours->index(PharaohColours::MAP_DUNE2, num3);
 	} else if (terrain & 0x40000) { // marshland
-		*c1 = colours->colour(PharaohColours::MAP_MARSH, (random & 4) >> 2);
-		*c2 = colours->colour(PharaohColours::MAP_MARSH, ((random & 4) >> 2) + 2);
+		*c1 = colours->index(PharaohColours::MAP_MARSH, (random & 4) >> 2);
+		*c2 = colours->index(PharaohColours::MAP_MARSH, ((random & 4) >> 2) + 2);
 	} else if (terrain & 0x804000) {// wall
-		*c1 = colours->colour(PharaohColours::MAP_WALL, 0);
-		*c2 = colours->colour(PharaohColours::MAP_WALL, 0);
+		*c1 = colours->index(PharaohColours::MAP_WALL, 0);
+		*c2 = colours->index(PharaohColours::MAP_WALL, 0);
 	} else if (terrain & 0x40000000) { // tomb chamber/tunnel
-		*c1 = colours->colour(PharaohColours::MAP_ROAD, 0);
-		*c2 = colours->colour(PharaohColours::MAP_ROAD, 1);
+		*c1 = colours->index(PharaohColours::MAP_ROAD, 0);
+		*c2 = colours->index(PharaohColours::MAP_ROAD, 1);
 	} else if (terrain & 0x10000000) { // monument plazas, etc
-		*c1 = colours->colour(PharaohColours::MAP_MONUMENTS, 1);
-		*c2 = colours->colour(PharaohColours::MAP_MONUMENTS, 0);
+		*c1 = colours->index(PharaohColours::MAP_MONUMENTS, 1);
+		*c2 = colours->index(PharaohColours::MAP_MONUMENTS, 0);
 	} else { // empty land or watered land
-		*c1 = colours->colour(PharaohColours::MAP_EMPTY1, random & 7);
-		*c2 = colours->colour(PharaohColours::MAP_EMPTY2, random & 7);
+		*c1 = colours->index(PharaohColours::MAP_EMPTY1, random & 7);
+		*c2 = colours->index(PharaohColours::MAP_EMPTY2, random & 7);
 	}
 }
 
 /**
-* Reads a compressed byte grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on a byte grid in decompressed data
 */
-Grid<unsigned char> *PharaohFile::readCompressedByteGrid() {
-	int length = readInt();
-	Grid<unsigned char> *g = new Grid<unsigned char>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readByte());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned char> PharaohFile::viewByteGrid(const unsigned char *data) {
+	return GridView<unsigned char>(data, MAX_MAPSIZE, MAX_MAPSIZE);
 }
 
 /**
-* Reads a compressed short grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on an uncompressed byte grid in the file.
 */
-Grid<unsigned short> *PharaohFile::readCompressedShortGrid() {
-	int length = readInt();
-	Grid<unsigned short> *g = new Grid<unsigned short>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readShort());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned char> PharaohFile::viewByteGrid() {
+	return viewByteGrid(getUncompressedData(MAX_MAPSIZE * MAX_MAPSIZE));
 }
 
 /**
-* Reads a compressed int grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on an int grid in decompressed data
 */
-Grid<unsigned int> *PharaohFile::readCompressedIntGrid() {
-	int length = readInt();
-	Grid<unsigned int> *g = new Grid<unsigned int>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readInt());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned int> PharaohFile::viewIntGrid(const unsigned char *data) {
+	return GridView<unsigned int>(data, MAX_MAPSIZE, MAX_MAPSIZE);
 }
 
 /**
-* Reads an uncompressed byte grid from the stream.
+* Returns a view on an uncompressed int grid in the file.
 */
-Grid<unsigned char> *PharaohFile::readByteGrid() {
-	Grid<unsigned char> *g = new Grid<unsigned char>(MAX_MAPSIZE, MAX_MAPSIZE);
-	char c;
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			in->read(&c, 1);
-			g->set(x, y, (unsigned char)c);
-		}
-	}
-	return g;
-}
-
-/**
-* Reads an uncompressed short grid from the stream.
-*/
-Grid<unsigned short> *PharaohFile::readShortGrid() {
-	Grid<unsigned short> *g = new Grid<unsigned short>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			g->set(x, y, readShort());
-		}
-	}
-	return g;
-}
-
-/**
-* Reads an uncompressed int grid from the stream.
-*/
-Grid<unsigned int> *PharaohFile::readIntGrid() {
-	Grid<unsigned int> *g = new Grid<unsigned int>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			g->set(x, y, readInt());
-		}
-	}
-	return g;
+GridView<unsigned int> PharaohFile::viewIntGrid() {
+	return viewIntGrid(getUncompressedData(MAX_MAPSIZE * MAX_MAPSIZE * 4));
 }
 
 /**
 * Reads the random data grid
 */
-Grid<unsigned char> *PharaohFile::getRandomData() {
+GridView<unsigned char> PharaohFile::getRandomData() {
 	// Assume the first 4 chunks of data have been read
 	// The next 4 (useless) compressed parts are stored in the same way
 	for (int i = 0; i < 4; i++) {
@@ -502,14 +440,15 @@ Grid<unsigned char> *PharaohFile::getRandomData() {
 	}
 	
 	// Here be the random data
-	return readByteGrid();
+	return viewByteGrid();
 }
 
 /**
-* Gets the walker info from the saved game, which is buried after
+* Queues the walker info from the saved game, which is buried after
 * a few "useless" compressed chunks.
+* @return int Index of the walker chunk in `chunks'
 */
-Walker * PharaohFile::getWalkers() {
+int PharaohFile::queueWalkers(ChunkDecoder *chunks) {
 	// Assume random data has been read already
 	// Which is followed by some more compressed data blocks
 	for (int i = 0; i < 5; i++) {
@@ -517,32 +456,31 @@ Walker * PharaohFile::getWalkers() {
 	}
 	
 	// Next come the walkers in compressed format
-	Walker *walkers = new Walker[MAX_WALKERS];
-	int length = readInt();
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		// Walker entry = 388 bytes
-		for (int i = 0; i < MAX_WALKERS; i++) {
-			pk.skip(10);
-			walkers[i].type = pk.readShort();
-			pk.skip(8);
-			walkers[i].x = pk.readShort();
-			walkers[i].y = pk.readShort();
-			pk.skip(364);
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete walkers;
-		throw;
+	return queueCompressed(chunks, MAX_WALKERS * 388);
+}
+
+/**
+* Reads the walker info from the decompressed walker table
+*/
+void PharaohFile::readWalkers(const unsigned char *data, WalkerTable *walkers) {
+	walkers->resize(MAX_WALKERS);
+	
+	// Walker entry = 388 bytes
+	const unsigned char *p = data;
+	for (int i = 0; i < MAX_WALKERS; i++) {
+		Walker &walker = (*walkers)[i];
+		walker.type = p[10] | (p[11] << 8);
+		walker.x = p[20] | (p[21] << 8);
+		walker.y = p[22] | (p[23] << 8);
+		p += 388;
 	}
-	return walkers;
 }
 
 /**
-* Gets the building info from the saved game
+* Queues the building info from the saved game
+* @return int Index of the building chunk in `chunks'
 */
-Building * PharaohFile::getBuildings() {
+int PharaohFile::queueBuildings(ChunkDecoder *chunks) {
 	// Assume walkers have been read already
 	
 	// Three compressed blocks
@@ -556,30 +494,30 @@ Building * PharaohFile::getBuildings() {
 	// Compressed block, followed by 72 bytes, followed by walkers
 	skipCompressed();
 	in->seekg(72, ios::cur);
-	Building *buildings = new Building[MAX_BUILDINGS];
-	int length = readInt();
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		// Building entry = 264 bytes
-		for (int i = 0; i < MAX_BUILDINGS; i++) {
-			pk.skip(3);
-			buildings[i].size = pk.readByte();
-			pk.skip(2);
-			buildings[i].x = pk.readShort();
-			buildings[i].y = pk.readShort();
-			pk.skip(6);
-			buildings[i].type = pk.readShort();
-			pk.skip(152);
-			buildings[i].rotation = pk.readByte();
-			pk.skip(93);
+	return queueCompressed(chunks, MAX_BUILDINGS * 264);
+}
+
+/**
+* Reads the building info from the decompressed building table
+*/
+void PharaohFile::readBuildings(const unsigned char *data, BuildingTable *buildings) {
+	Building building;
+	
+	// Building entry = 264 bytes
+	buildings->reserve(MAX_BUILDINGS);
+	const unsigned char *p = data;
+	for (int i = 0; i < MAX_BUILDINGS; i++, p += 264) {
+		building.type = p[16] | (p[17] << 8);
+		if (building.type == 0) {
+			// building slot unused
+			continue;
 		}
-		pk.empty();
-	} catch (PKException) {
-		delete buildings;
-		throw;
+		building.size = p[3];
+		building.x = p[6] | (p[7] << 8);
+		building.y = p[8] | (p[9] << 8);
+		building.rotation = p[170];
+		buildings->push_back(building);
 	}
-	return buildings;
 }
 
 /**
@@ -610,6 +548,51 @@ void PharaohFile::skipCompressed() {
 	in->seekg(skip, ios::cur);
 }
 
+/**
+* Queues the compressed data block at the current position for
+* decompression. Compressed chunks consist of a length followed by a
+* compressed chunk of that length
+* @param size Length of the decompressed data
+* @return int Index of the chunk in `chunks'
+*/
+int PharaohFile::queueCompressed(ChunkDecoder *chunks, int size) {
+	int length = readInt();
+	const unsigned char *chunk = getCompressedData(&length);
+	return chunks->add(chunk, length, size);
+}
+
+/**
+* Returns the compressed data block at the current position straight
+* from the mapped file, and moves the stream past it
+* @param length Length of the block. Shortened if the file ends early
+*/
+const unsigned char *PharaohFile::getCompressedData(int *length) {
+	int offset = in->tellg();
+	if (offset < 0 || offset > file->size()) {
+		offset = file->size();
+	}
+	if (*length < 0 || *length > file->size() - offset) {
+		*length = file->size() - offset;
+	}
+	in->seekg(offset + *length, ios::beg);
+	return file->data() + offset;
+}
+
+/**
+* Returns the uncompressed data at the current position straight from
+* the mapped file, and moves the stream past it
+* @param length Number of bytes needed
+* @throws const char* if the file ends before that
+*/
+const unsigned char *PharaohFile::getUncompressedData(int length) {
+	int offset = in->tellg();
+	if (offset < 0 || length > file->size() - offset) {
+		throw "Unexpected end of file";
+	}
+	in->seekg(offset + length, ios::beg);
+	return file->data() + offset;
+}
+
 /**
 * Reads an integer from the stream
 */
@@ -624,15 +607,6 @@ unsigned int PharaohFile::readInt() {
 	return number;
 }
 
-/**
-* Reads a short from the stream
-*/
-unsigned short PharaohFile::readShort() {
-	char data[2];
-	in->read(data, 2);
-	return (unsigned short)(data[0] + (data[1] << 8));
-}
-
 /**
 * Returns the bitmap coordinates for a given map coordinate
 */
@@ -642,19 +616,29 @@ void PharaohFile::getBitmapCoordinates(int x, int y, int mapsize, int *x_out, in
 }
 
 int main(int argc, char **argv) {
-	if (argc != 3) {
-		cerr << "Usage: "<<argv[0] << " [pharaoh file] [png output file]" << endl;
+	// Optional compression preset before the file names
+	PNGCompression compression = PNGWriter::BALANCED;
+	int arg = 1;
+	if (argc == 5 && string(argv[1]) == "-c") {
+		if (!PNGWriter::preset(argv[2], &compression)) {
+			cerr << "Unknown compression preset: " << argv[2] << endl;
+			return 1;
+		}
+		arg = 3;
+	}
+	if (argc - arg != 2) {
+		cerr << "Usage: " << argv[0] << " [-c fast|balanced|smallest] [pharaoh file] [png output file]" << endl;
 		return 1;
 	}
 	try {
-		PharaohFile *pf = new PharaohFile(string(argv[1]));
-		PNGImage *img = pf->getImage();
+		Arena arena;
+		PharaohFile pf(argv[arg], &arena);
+		unique_ptr<IndexedPNGImage> img = pf.getImage();
 		
 		if (img) {
-			img->write(argv[2]);
-			delete img;
+			img->setCompression(compression);
+			img->write(argv[arg + 1]);
 		}
-		delete pf;
 	} catch (...) {
 		cerr << "Couldn't process file. Make sure it's a valid Pharaoh file." << endl;
 		return 2;
@@ -19,60 +19,59 @@
 #ifndef pharaohfile_h
 #define pharaohfile_h
 
-#include "pngimage.h"
-#include "grid.h"
+#include "indexedpngimage.h"
+#include "mapmodel.h"
+#include "mappedfile.h"
+#include "chunkdecoder.h"
 #include "pharaohcolours.h"
 #include <string>
 #include <iostream>
-
-typedef struct {
-	unsigned short type;
-	unsigned short x;
-	unsigned short y;
-} Walker;
-
-typedef struct {
-	unsigned short type;
-	unsigned short x;
-	unsigned short y;
-	unsigned char size;
-	unsigned char rotation;
-} Building;
+#include <fstream>
+#include <memory>
+#include <vector>
 
 class PharaohFile {
 	public:
-		PharaohFile(std::string filename);
-		~PharaohFile();
+		PharaohFile(std::string filename, Arena *arena = NULL);
+		
+		std::unique_ptr<IndexedPNGImage> getImage();
 		
-		PNGImage *getImage();
+		/**
+		* Parses the file into a MapModel.
+		* @return MapModel* the map, or NULL if the file couldn't be opened
+		*/
+		std::unique_ptr<MapModel> getModel();
 	
 	private:
-		void placeBuildings(PNGImage *img, Building *buildings,
-			 Grid<unsigned int> *terrain, Grid<unsigned char> *edges,
-			 int mapsize);
-		void placeBuilding(PNGImage *img, Grid<unsigned char> *edges,
+		std::unique_ptr<IndexedPNGImage> drawModel(const MapModel *model);
+		void placeBuildings(IndexedPNGImage *img, const MapModel *model);
+		void placeBuilding(IndexedPNGImage *img, const MapGrid<unsigned char> *edges,
 			int mapsize, int posX, int posY,
 			int sizeX, int sizeY, int c1, int c2);
 		void getBuildingColours(unsigned int building, unsigned char edge,
 			unsigned char edge_right, unsigned char edge_below, int *c1, int *c2);
 		void getTerrainColours(unsigned int terrain, unsigned char random, int *c1, int *c2);
-		Grid<unsigned char> *readCompressedByteGrid();
-		Grid<unsigned short> *readCompressedShortGrid();
-		Grid<unsigned int> *readCompressedIntGrid();
-		Grid<unsigned char> *readByteGrid();
-		Grid<unsigned short> *readShortGrid();
-		Grid<unsigned int> *readIntGrid();
-		Grid<unsigned char> *getRandomData();
-		Walker *getWalkers();
-		Building *getBuildings();
+		GridView<unsigned char> viewByteGrid(const unsigned char *data);
+		GridView<unsigned char> viewByteGrid();
+		GridView<unsigned int> viewIntGrid(const unsigned char *data);
+		GridView<unsigned int> viewIntGrid();
+		GridView<unsigned char> getRandomData();
+		int queueWalkers(ChunkDecoder *chunks);
+		void readWalkers(const unsigned char *data, WalkerTable *walkers);
+		int queueBuildings(ChunkDecoder *chunks);
+		void readBuildings(const unsigned char *data, BuildingTable *buildings);
 		int getMapsize();
 		void skipCompressed();
+		int queueCompressed(ChunkDecoder *chunks, int size);
+		const unsigned char *getCompressedData(int *length);
+		const unsigned char *getUncompressedData(int length);
 		unsigned int readInt();
-		unsigned short readShort();
 		void getBitmapCoordinates(int x, int y, int mapsize, int *x_out, int *y_out);
 		
-		std::ifstream *in;
-		PharaohColours *colours;
+		std::unique_ptr<std::ifstream> in;
+		std::unique_ptr<MappedFile> file;
+		std::unique_ptr<PharaohColours> colours;
+		Arena *arena;
 		static const int
 			MAX_MAPSIZE = 228,
 			MAX_WALKERS = 2000,
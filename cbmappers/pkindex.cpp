@@ -0,0 +1,163 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "pkindex.h"
+#include <fstream>
+#include <zlib.h>
+
+using namespace std;
+
+/**
+* Sidecar file layout, all ints little-endian:
+*   "PKIX", compressed length, CRC-32 of the compressed data, number of
+*   checkpoints, then for each checkpoint: output offset, bit offset,
+*   window length, window bytes
+*/
+static const char MAGIC[] = "PKIX";
+
+static void writeInt(ofstream *out, int number) {
+	char data[4];
+	for (int i = 0; i < 4; i++) {
+		data[i] = (char)((unsigned int)number >> (i*8));
+	}
+	out->write(data, 4);
+}
+
+static unsigned int crc(const unsigned char *src, int length) {
+	return crc32(crc32(0, Z_NULL, 0), src, length);
+}
+
+static int readInt(ifstream *in) {
+	unsigned char data[4] = {0, 0, 0, 0};
+	in->read((char *)data, 4);
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int)data[3] << 24);
+}
+
+PKIndex::PKIndex() {
+	compressed_length = 0;
+	checksum = 0;
+}
+
+PKStatus PKIndex::build(const unsigned char *src, int length, int size, int interval) {
+	PKWareInputStream pk;
+	
+	checkpoints.clear();
+	compressed_length = length;
+	checksum = crc(src, length);
+	if (pk.reset(src, length) != PK_OK) {
+		return PK_CORRUPT;
+	}
+	if (size <= 0) {
+		return PK_OK; // nothing to index
+	}
+	vector<unsigned char> data(size);
+	return pk.decompress(data.data(), size, interval, &checkpoints);
+}
+
+PKStatus PKIndex::read(const unsigned char *src, int length, int offset,
+		unsigned char *dst, int count, int *written) {
+	if (written) {
+		*written = 0;
+	}
+	if (checkpoints.empty() || length != compressed_length || offset < 0) {
+		return PK_CORRUPT;
+	}
+	
+	// Find the last checkpoint at or before `offset'
+	int low = 0, high = checkpoints.size() - 1;
+	while (low < high) {
+		int middle = (low + high + 1) / 2;
+		if (checkpoints[middle].output_offset <= offset) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+	const PKCheckpoint *checkpoint = &checkpoints[low];
+	
+	PKWareInputStream pk;
+	int skipped, read;
+	if (pk.reset(src, length, checkpoint) != PK_OK) {
+		return PK_CORRUPT;
+	}
+	PKStatus status = pk.decode(NULL, offset - checkpoint->output_offset, &skipped);
+	if (status != PK_OK) {
+		return status;
+	}
+	status = pk.decode(dst, count, &read);
+	if (written) {
+		*written = read;
+	}
+	return status;
+}
+
+bool PKIndex::save(string filename) {
+	ofstream out(filename.c_str(), ios::out | ios::binary);
+	if (!out.is_open()) {
+		return false;
+	}
+	out.write(MAGIC, 4);
+	writeInt(&out, compressed_length);
+	writeInt(&out, checksum);
+	writeInt(&out, checkpoints.size());
+	for (unsigned int i = 0; i < checkpoints.size(); i++) {
+		writeInt(&out, checkpoints[i].output_offset);
+		writeInt(&out, checkpoints[i].bit_offset);
+		writeInt(&out, checkpoints[i].window_length);
+		out.write((const char *)checkpoints[i].window, checkpoints[i].window_length);
+	}
+	return out.good();
+}
+
+bool PKIndex::load(string filename, const unsigned char *src, int length) {
+	ifstream in(filename.c_str(), ios::in | ios::binary);
+	char magic[4];
+	
+	checkpoints.clear();
+	if (!in.is_open() || !in.read(magic, 4) || string(magic, 4) != MAGIC) {
+		return false;
+	}
+	compressed_length = readInt(&in);
+	checksum = readInt(&in);
+	if (compressed_length != length || checksum != crc(src, length)) {
+		return false; // stale: the data has changed since
+	}
+	int count = readInt(&in);
+	for (int i = 0; i < count && in.good(); i++) {
+		PKCheckpoint checkpoint;
+		checkpoint.output_offset = readInt(&in);
+		checkpoint.bit_offset = readInt(&in);
+		checkpoint.window_length = readInt(&in);
+		// Each checkpoint comes after the previous one, with all of the
+		// output before it in its window, up to 4096 bytes
+		int previous = checkpoints.empty() ? -1 : checkpoints.back().output_offset;
+		int window = (checkpoint.output_offset < 4096) ? checkpoint.output_offset : 4096;
+		if (checkpoint.output_offset <= previous || (i == 0 && checkpoint.output_offset != 0) ||
+				checkpoint.bit_offset < 16 || checkpoint.bit_offset > length * 8 ||
+				checkpoint.window_length != window) {
+			break;
+		}
+		in.read((char *)checkpoint.window, checkpoint.window_length);
+		checkpoints.push_back(checkpoint);
+	}
+	if (!in.good() || (int)checkpoints.size() != count) {
+		checkpoints.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,78 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef pkindex_h
+#define pkindex_h
+
+#include "pkwareinputstream.h"
+#include <string>
+#include <vector>
+
+/**
+* Index of checkpoints into one compressed block, for reading parts of
+* large record tables without decompressing everything before them.
+* The index can be saved next to the file it belongs to and loaded
+* again later.
+*/
+class PKIndex {
+	public:
+		PKIndex();
+		
+		/**
+		* Decompresses a block once to build the index. This needs `size'
+		* bytes of memory for the whole decompressed block while it runs,
+		* as each checkpoint copies its window from the data before it.
+		* An empty block gets an empty index.
+		* @param src Compressed data, including the 2-byte header
+		* @param length Length of the compressed data
+		* @param size Length of the decompressed data
+		* @param interval Distance between checkpoints in decompressed
+		* bytes. Each checkpoint takes up a little over 4 KB
+		*/
+		PKStatus build(const unsigned char *src, int length, int size, int interval);
+		
+		/**
+		* Decompresses `count' bytes starting at `offset', decoding only
+		* from the nearest checkpoint before `offset'
+		* @param src The same compressed data the index was built for
+		* @param written If not NULL, set to the number of bytes written
+		*/
+		PKStatus read(const unsigned char *src, int length, int offset,
+			unsigned char *dst, int count, int *written = NULL);
+		
+		/**
+		* Writes the index to file `filename'
+		* @return bool Whether the file could be written
+		*/
+		bool save(std::string filename);
+		
+		/**
+		* Reads an index written by save() for compressed block `src'
+		* @return bool Whether the file could be read and is a valid index
+		* for `src'. An index for other data, e.g. for an older version
+		* of the file, is rejected.
+		*/
+		bool load(std::string filename, const unsigned char *src, int length);
+	
+	private:
+		std::vector<PKCheckpoint> checkpoints;
+		int compressed_length; // of the block the index belongs to
+		unsigned int checksum; // CRC-32 of that block
+};
+
+#endif /* pkindex_h */
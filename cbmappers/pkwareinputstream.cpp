@@ -46,50 +46,129 @@ SOFTWARE.
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 using namespace std;
 
+#ifndef PKWARE_BRANCHY_DECODER
 /**
-* Dictionary for keeping track of past read bytes
+* Lookup tables for the copy length and copy offset codes. Both are
+* prefix codes of at most 8 bits, so one lookup on the next 8 bits of
+* input gives the symbol and the number of bits its code takes up.
+* Codes are stored in the order the bits are read (LSB first).
 */
-class PKDictionary {
+class PKHuffmanTables {
 	public:
-		/**
-		* Creates a new dictionary of size `size'
-		*/
-		PKDictionary(int size) {
-			dictionary = new unsigned char[size];
-			this->size = size;
-			this->first = -1;
-		}
+		struct LengthCode {
+			unsigned char bits;  // length of the code
+			unsigned char extra; // number of extra bits following the code
+			unsigned short base; // copy length for extra bits == 0
+		};
+		struct OffsetCode {
+			unsigned char bits;  // length of the code
+			unsigned char value; // high bits of the copy offset
+		};
 		
-		~PKDictionary() {
-			delete[] dictionary;
-		}
+		LengthCode length[256];
+		OffsetCode offset[256];
 		
-		/**
-		* Returns the byte at the specified position.
-		* Also does a PUT for this byte since the compression
-		* algorithm requires it
-		*/
-		unsigned char get(int position) {
-			int index = (size + first - position) % size;
-			put(dictionary[index]);
-			return dictionary[index];
+		PKHuffmanTables() {
+			static const unsigned char lengthBits[17] = {
+				3, 2, 3, 3, 4, 4, 4, 5, 6, 6, 5, 5, 6, 6, 6, 7, 7
+			};
+			static const unsigned char lengthCodes[17] = {
+				0x05, 0x03, 0x01, 0x06, 0x0a, 0x02, 0x0c, 0x14, 0x04,
+				0x24, 0x18, 0x08, 0x30, 0x10, 0x20, 0x40, 0x00
+			};
+			static const unsigned char lengthExtra[17] = {
+				0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 4, 5, 6, 7, 8
+			};
+			static const unsigned short lengthBase[17] = {
+				2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 16, 24, 40, 72, 136, 264
+			};
+			static const unsigned char offsetBits[64] = {
+				2, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+				6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+				7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+				8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8
+			};
+			static const unsigned char offsetCodes[64] = {
+				0x03, 0x0d, 0x05, 0x19, 0x09, 0x11, 0x01, 0x3e,
+				0x1e, 0x2e, 0x0e, 0x36, 0x16, 0x26, 0x06, 0x3a,
+				0x1a, 0x2a, 0x0a, 0x32, 0x12, 0x22, 0x42, 0x02,
+				0x7c, 0x3c, 0x5c, 0x1c, 0x6c, 0x2c, 0x4c, 0x0c,
+				0x74, 0x34, 0x54, 0x14, 0x64, 0x24, 0x44, 0x04,
+				0x78, 0x38, 0x58, 0x18, 0x68, 0x28, 0x48, 0x08,
+				0xf0, 0x70, 0xb0, 0x30, 0xd0, 0x50, 0x90, 0x10,
+				0xe0, 0x60, 0xa0, 0x20, 0xc0, 0x40, 0x80, 0x00
+			};
+			
+			// Every index whose lowest `bits' bits match the code decodes
+			// to that symbol
+			for (int i = 0; i < 17; i++) {
+				for (int j = lengthCodes[i]; j < 256; j += 1 << lengthBits[i]) {
+					length[j].bits = lengthBits[i];
+					length[j].extra = lengthExtra[i];
+					length[j].base = lengthBase[i];
+				}
+			}
+			for (int i = 0; i < 64; i++) {
+				for (int j = offsetCodes[i]; j < 256; j += 1 << offsetBits[i]) {
+					offset[j].bits = offsetBits[i];
+					offset[j].value = (unsigned char)i;
+				}
+			}
 		}
-		
-		/**
-		* Adds a byte to the dictionary
-		*/
-		void put(unsigned char b) {
-			first = (first + 1) % size;
-			dictionary[first] = b;
+};
+
+static const PKHuffmanTables huffman;
+#endif
+
+/**
+* Copies `length' bytes starting `offset' bytes back in the output to
+* `out' a word at a time: 16 bytes per step with SSE2 once the offset
+* allows it, 8 bytes otherwise. If the offset is shorter than a word,
+* the source overlaps the destination and the copy repeats an
+* `offset'-byte pattern. The first repeats are then copied byte by byte
+* until a whole number of them spans a word; from there on words can be
+* copied from that larger distance.
+*/
+static inline void copyMatch(unsigned char *out, int offset, int length) {
+	int i = 0;
+	if (offset < 8) {
+		if (offset == 1) {
+			// Runs of a single byte, e.g. the zeroes of empty grids
+			memset(out, out[-1], length);
+			return;
+		}
+		int distance = ((8 + offset - 1) / offset) * offset;
+		int head = (distance < length) ? distance : length;
+		for (; i < head; i++) {
+			out[i] = out[i - offset];
 		}
+		offset = distance;
+	}
 	
-	private:
-		int size;
-		int first;
-		unsigned char *dictionary;
-};
+	const unsigned char *from = out - offset;
+#ifdef __SSE2__
+	if (offset >= 16) {
+		for (; i + 16 <= length; i += 16) {
+			_mm_storeu_si128((__m128i *)(out + i),
+				_mm_loadu_si128((const __m128i *)(from + i)));
+		}
+	}
+#endif
+	for (; i + 8 <= length; i += 8) {
+		unsigned long long word;
+		memcpy(&word, from + i, 8);
+		memcpy(out + i, &word, 8);
+	}
+	for (; i < length; i++) {
+		out[i] = from[i];
+	}
+}
 
 PKWareInputStream::PKWareInputStream(string filename, int file_length) {
 	ifstream *i = new ifstream();
@@ -101,106 +180,266 @@ PKWareInputStream::PKWareInputStream(string filename, int file_length) {
 	input = i;
 	this->close_stream = true;
 	this->file_length = file_length;
-	init();
+	out_buffer = NULL;
+	out_capacity = 0;
+	init(-1);
 }
 
-PKWareInputStream::PKWareInputStream(istream *i, bool close_stream, int file_length) {
+PKWareInputStream::PKWareInputStream(istream *i, bool close_stream,
+		int file_length, int output_length) {
 	input = i;
 	this->close_stream = close_stream;
 	this->file_length = file_length;
-	init();
+	out_buffer = NULL;
+	out_capacity = 0;
+	init(output_length);
+}
+
+PKWareInputStream::PKWareInputStream(const unsigned char *data, int length,
+		int output_length) {
+	input = NULL;
+	close_stream = false;
+	file_length = length;
+	inPos = data;
+	inEnd = data + length;
+	out_buffer = NULL;
+	out_capacity = 0;
+	init(output_length);
+}
+
+PKWareInputStream::PKWareInputStream() {
+	input = NULL;
+	close_stream = false;
+	out_buffer = NULL;
+	out_capacity = 0;
+	output = NULL;
+	status = PK_END_OF_STREAM; // nothing to read until reset()
+	error = NULL;
+	pushing = false;
+	win_pos = win_end = 0;
 }
 
 PKWareInputStream::~PKWareInputStream() {
-	delete dictionary;
-	delete buffer;
+	delete[] out_buffer;
 	if (close_stream) {
 		delete input;
 	}
 }
 
-unsigned char PKWareInputStream::read() {
-	if (read_copying) {
-		//cout << "Copying bytes from offset " << read_offset << "; " << read_length << " bytes left" << endl;
-		read_length--;
-		if (read_length <= 0) {
-			read_copying = false;
-		}
-		unsigned char b = dictionary->get(read_offset);
-		return b;
-	} else {
-		if (readBit() == 0) {
-			// Copy byte verbatim
-			int result = readBits(8);
-			dictionary->put((unsigned char)result);
-			//cout << "Reading verbatim byte: " << result << endl;
-			return (unsigned char)result;
+PKStatus PKWareInputStream::reset(const unsigned char *data, int length,
+		int output_length) {
+	if (close_stream) {
+		delete input;
+	}
+	input = NULL;
+	close_stream = false;
+	file_length = length;
+	inPos = data;
+	inEnd = data + length;
+	return start(output_length);
+}
+
+void PKWareInputStream::reset() {
+	if (close_stream) {
+		delete input;
+	}
+	input = NULL;
+	close_stream = false;
+	file_length = -1;
+	inPos = inEnd = NULL;
+	status = PK_OK;
+	error = NULL;
+	output = NULL;
+	eof_reached = false;
+	bitBuffer = 0;
+	bitCount = 0;
+	win_pos = win_end = 0;
+	pushing = true;
+	header_bytes = 0;
+	inStart = NULL;
+}
+
+PKStatus PKWareInputStream::reset(const unsigned char *data, int length,
+		const PKCheckpoint *checkpoint) {
+	if (reset(data, length) != PK_OK) {
+		return status;
+	}
+	int bit_offset = checkpoint->bit_offset;
+	if (bit_offset < 16 || bit_offset > length * 8 ||
+			checkpoint->window_length < 0 ||
+			checkpoint->window_length > MAX_DICT_SIZE) {
+		fail(PK_CORRUPT, "Invalid checkpoint");
+		return status;
+	}
+	inPos = data + bit_offset / 8;
+	bitBuffer = 0;
+	bitCount = 0;
+	refillBits();
+	dropBits(bit_offset % 8);
+	
+	// The window is the dictionary for the copies that follow
+	memcpy(window, checkpoint->window, checkpoint->window_length);
+	win_pos = win_end = checkpoint->window_length;
+	return status;
+}
+
+void PKWareInputStream::feed(const unsigned char *data, int length) {
+	inPos = data;
+	inEnd = data + length;
+	// The header may come in bits and pieces as well
+	while (header_bytes < 2 && inPos < inEnd) {
+		header[header_bytes++] = (char)*inPos++;
+		if (header_bytes == 2) {
+			parseHeader(header);
 		}
-		// Needs to copy stuff from the dictionary
-		read_length = getCopyLength();
-		if (read_length >= 519) {
-			//cout << "519 read: end of file" << endl;
-			throw PKException("EOF");
+	}
+}
+
+void PKWareInputStream::finish() {
+	eof_reached = true;
+	if (header_bytes < 2) {
+		fail(PK_TRUNCATED, "File too small");
+	}
+}
+
+PKStatus PKWareInputStream::decompress(unsigned char *dst, int capacity, int *written) {
+	int count = 0;
+	if (status == PK_OK && !output && win_end == 0) {
+		count = decodeTokens(dst, 0, capacity, capacity);
+	}
+	skipInput();
+	if (written) {
+		*written = count;
+	}
+	return status;
+}
+
+void PKWareInputStream::decompress(int count, PKWareInputStream **decoders,
+		unsigned char **dst, const int *capacity, PKStatus *status, int *written) {
+	int pos[MAX_INTERLEAVE];
+	int limit[MAX_INTERLEAVE];
+	int active = 0;
+	for (int i = 0; i < count; i++) {
+		PKWareInputStream *pk = decoders[i];
+		pos[i] = 0;
+		limit[i] = (pk->status == PK_OK && !pk->output && pk->win_end == 0) ?
+			capacity[i] : 0;
+		if (limit[i] > 0) {
+			active++;
 		}
-		
-		read_offset = getCopyOffset(read_length);
-		//cout << "Copying " << read_length << " bytes from offset " << read_offset << endl;
-		unsigned char b = dictionary->get(read_offset);
-		read_length--;
-		read_copying = true;
-		return b;
 	}
+	
+	// A short run of each block in turn; smaller steps spend more time
+	// switching between decoders than they gain
+	while (active > 0) {
+		for (int i = 0; i < count; i++) {
+			if (pos[i] < limit[i]) {
+				PKWareInputStream *pk = decoders[i];
+				int step = (limit[i] - pos[i] > STEP) ? pos[i] + STEP : limit[i];
+				pos[i] = pk->decodeTokens(dst[i], pos[i], step, capacity[i]);
+				if (pos[i] >= limit[i] || pk->status != PK_OK) {
+					limit[i] = 0;
+					active--;
+				}
+			}
+		}
+	}
+	
+	for (int i = 0; i < count; i++) {
+		decoders[i]->skipInput();
+		status[i] = decoders[i]->status;
+		if (written) {
+			written[i] = pos[i];
+		}
+	}
+}
+
+PKStatus PKWareInputStream::decompress(unsigned char *dst, int capacity,
+		int interval, vector<PKCheckpoint> *checkpoints, int *written) {
+	int pos = 0;
+	if (interval <= 0) {
+		interval = capacity;
+	}
+	if (status == PK_OK && !output && win_end == 0 && inStart) {
+		while (status == PK_OK && pos < capacity) {
+			// Tokens don't stop at exact multiples of `interval', so the
+			// checkpoint goes at the first token boundary after it
+			PKCheckpoint checkpoint;
+			checkpoint.output_offset = pos;
+			checkpoint.bit_offset = (int)(inPos - inStart) * 8 - bitCount;
+			checkpoint.window_length = (pos < MAX_DICT_SIZE) ? pos : MAX_DICT_SIZE;
+			memcpy(checkpoint.window, dst + pos - checkpoint.window_length,
+				checkpoint.window_length);
+			checkpoints->push_back(checkpoint);
+			
+			int limit = (pos / interval + 1) * interval;
+			pos = decodeTokens(dst, pos, (limit < capacity) ? limit : capacity, capacity);
+		}
+	}
+	if (written) {
+		*written = pos;
+	}
+	return status;
+}
+
+unsigned char PKWareInputStream::read() {
+	unsigned char b;
+	int count;
+	PKStatus result = decode(&b, 1, &count);
+	if (result != PK_OK) {
+		throw PKException(result == PK_END_OF_STREAM ? "EOF" : error);
+	}
+	return b;
 }
 
 int PKWareInputStream::read(unsigned char *buf, int length) {
+	int count;
+	PKStatus result = decode(buf, length, &count);
+	if (result == PK_CORRUPT || result == PK_TRUNCATED) {
+		throw PKException(error);
+	}
+	return count;
+}
+
+PKStatus PKWareInputStream::decode(unsigned char *buf, int length, int *count) {
+	if (output) {
+		int available = out_length - out_offset;
+		int current = (length > available) ? available : length;
+		if (buf) {
+			memcpy(buf, output + out_offset, current);
+		}
+		out_offset += current;
+		*count = current;
+		if (current == length) {
+			return PK_OK;
+		}
+		// A block cut short by corruption or truncation reports that,
+		// not a plain end of stream
+		return (status != PK_OK) ? status : PK_END_OF_STREAM;
+	}
+	
 	int current = 0;
-	try {
-		int max = length;
-		while (current < max) {
-			if (read_copying) {
-				while (current < max && read_copying) {
-					read_length--;
-					if (read_length <= 0) {
-						read_copying = false;
-					}
-					if (buf) {
-						buf[current++] = dictionary->get(read_offset);
-					} else {
-						dictionary->get(read_offset);
-					}
-				}
-			} else if (readBit() == 0) {
-				// Copy byte verbatim
-				int result = readBits(8);
-				dictionary->put((unsigned char)result);
-				if (buf) {
-					buf[current++] = (unsigned char)result;
-				}
-			} else {
-				// Needs to copy stuff from the dictionary
-				read_length = getCopyLength();
-				if (read_length >= 519) {
-					return current;
-				}
-				
-				read_offset = getCopyOffset(read_length);
-				if (buf) {
-					buf[current++] = dictionary->get(read_offset);
-				} else {
-					dictionary->get(read_offset);
-				}
-				read_length--;
-				read_copying = true;
+	while (current < length) {
+		if (win_pos == win_end) {
+			if (status != PK_OK) {
+				break;
 			}
+			if (!fillWindow()) {
+				*count = current;
+				return PK_NEED_INPUT;
+			}
+			continue;
 		}
-		return current;
-	} catch (PKException e) {
-		if (e.msg == "EOF") {
-			//cout << "EOF thrown, current = " << current << endl;
-			return current;
+		int available = win_end - win_pos;
+		int part = (length - current < available) ? length - current : available;
+		if (buf) {
+			memcpy(buf + current, window + win_pos, part);
 		}
-		throw;
+		win_pos += part;
+		current += part;
 	}
+	*count = current;
+	return (current == length) ? PK_OK : status;
 }
 
 unsigned char PKWareInputStream::readByte() {
@@ -225,14 +464,14 @@ unsigned int PKWareInputStream::readInt() {
 }
 
 /**
-* Skips length bytes from the input
-* @todo Make much more efficient
+* Skips length bytes from the input. The skipped bytes are still
+* decoded, a window at a time, but never copied anywhere.
 */
 void PKWareInputStream::skip(int length) {
-	//read(NULL, length);
-	
-	for (int i = 0; i < length; i++) {
-		read();
+	int count;
+	PKStatus result = decode(NULL, length, &count);
+	if (result != PK_OK) {
+		throw PKException(result == PK_END_OF_STREAM ? "EOF" : error);
 	}
 }
 
@@ -240,32 +479,65 @@ void PKWareInputStream::skip(int length) {
 * Reads from the stream (and discards) until EOF is encountered
 */
 void PKWareInputStream::empty() {
-	//int i = 0;
-	try {
-		bool success = true;
-		while (success) {
-			read();
-			//i++;
-		}
-	} catch (PKException e) {
-		if (e.msg == "EOF") {
-			//cout << "Emptied. " << i << " bytes discarded" << endl;
-			return;
-		}
-		throw;
+	int count;
+	PKStatus result;
+	do {
+		result = decode(NULL, BUFFER_SIZE, &count);
+	} while (result == PK_OK);
+	if (result != PK_END_OF_STREAM) {
+		throw PKException(error);
 	}
 }
 
+PKStatus PKWareInputStream::decompressChunk(const unsigned char *src, int length,
+		unsigned char *dst, int capacity, int *written) {
+	PKWareInputStream pk;
+	pk.reset(src, length);
+	return pk.decompress(dst, capacity, written);
+}
+
+PKStatus PKWareInputStream::decompressChunk(istream *input, int length,
+		unsigned char *dst, int capacity, int *written) {
+	PKWareInputStream pk;
+	pk.input = input;
+	pk.file_length = length;
+	pk.start(-1);
+	return pk.decompress(dst, capacity, written);
+}
+
 ///////////////////////////
 // Private class methods //
 ///////////////////////////
 
 /**
-* Initialises the stream
+* Initialises the stream, throwing an exception if that fails
+* @param output_length Decompressed length if known, -1 otherwise
+*/
+void PKWareInputStream::init(int output_length) {
+	PKStatus result = start(output_length);
+	if (result == PK_CORRUPT || result == PK_TRUNCATED) {
+		throw PKException(error);
+	}
+}
+
+/**
+* Initialises the stream. Errors are reported through the return value.
+* @param output_length Decompressed length if known, -1 otherwise. If
+* given, the whole block is decompressed right away.
 */
-void PKWareInputStream::init() {
+PKStatus PKWareInputStream::start(int output_length) {
+	status = PK_OK;
+	error = NULL;
+	output = NULL;
+	pushing = false;
+	inStart = input ? NULL : inPos;
+	eof_reached = (input == NULL); // memory has all data available at once
+	bitBuffer = 0;
+	bitCount = 0;
+	win_pos = win_end = 0;
+	
 	// First get the file length if it hasn't been given
-	if (file_length == -1) {
+	if (input && file_length == -1) {
 		int current = input->tellg();
 		input->seekg(0, ios::end);
 		file_length = (int)input->tellg() - current;
@@ -273,48 +545,179 @@ void PKWareInputStream::init() {
 		//cout << "Discovered file length: " << file_length << endl;
 	}
 	if (file_length <= 2) {
-		throw PKException("File too small");
+		fail(PK_TRUNCATED, "File too small");
+		return status;
 	}
-	eof_reached = false;
-	readHeader();
-	fillBuffer();
-	// Init the remaining variables
-	bufBit = 0;
-	read_offset = 0;
-	read_length = 0;
-	read_copying = false;
+	if (readHeader() != PK_OK) {
+		return status;
+	}
+	if (input) {
+		fillBuffer();
+	}
+	
+	if (output_length >= 0) {
+		// Decompress everything right away, using the output buffer as the
+		// dictionary. The buffer is kept for the next reset()
+		if (output_length > out_capacity) {
+			delete[] out_buffer;
+			out_buffer = new unsigned char[output_length];
+			out_capacity = output_length;
+		}
+		output = out_buffer;
+		out_offset = 0;
+		out_length = decodeTokens(output, 0, output_length, output_length);
+		skipInput();
+	}
+	return status;
 }
 
 /**
-* Reads the 2-byte header and initialises the dictionary
+* Records an error. Decoding stops at the next token, and the methods
+* that throw exceptions use `message' for them.
 */
-void PKWareInputStream::readHeader() {
+void PKWareInputStream::fail(PKStatus error_status, const char *message) {
+	if (status == PK_OK) {
+		status = error_status;
+		error = message;
+	}
+}
+
+/**
+* Reads the 2-byte header and sets up the dictionary size
+*/
+PKStatus PKWareInputStream::readHeader() {
 	// Read the header to decide on the encoding type
-	char c;
-	input->read(&c, 1);
-	if (c != 0) {
-		throw PKException("Static dictionary not supported");
+	char header[2];
+	if (input) {
+		input->read(header, 2);
+	} else {
+		header[0] = (char)inPos[0];
+		header[1] = (char)inPos[1];
+		inPos += 2;
+	}
+	file_length -= 2; // Subtract two header bytes from total file length
+	return parseHeader(header);
+}
+
+/**
+* Checks the 2-byte header and sets up the dictionary size
+*/
+PKStatus PKWareInputStream::parseHeader(const char *header) {
+	if (header[0] != 0) {
+		fail(PK_CORRUPT, "Static dictionary not supported");
+		return status;
 	}
 	
-	input->read(&c, 1);
-	dictionary_bits = (int)c;
+	dictionary_bits = (int)header[1];
 	switch (dictionary_bits) {
 		case 4: dictSize = 1024; break;
 		case 5: dictSize = 2048; break;
 		case 6: dictSize = 4096; break;
 		default:
-			throw PKException("Unknown dictionary size");
+			fail(PK_CORRUPT, "Unknown dictionary size");
+			break;
 	}
-	dictionary = new PKDictionary(dictSize);
-	buffer = new char[BUFFER_SIZE];
 	//System.out.println("Dictionary size: "+dictSize);
-	file_length -= 2; // Subtract two header bytes from total file length
+	return status;
+}
+
+/**
+* Decodes the stream into `dst' from position `pos' onwards, until the
+* end of the stream is reached or `limit' bytes have been reached. The
+* decoded output itself serves as the dictionary, so copies are plain
+* memory moves within `dst', possibly reaching back before `pos'.
+* @param capacity Size of `dst'. Nothing is written past it, whatever
+* `limit' is: the last copy is cut short if it doesn't fit, which it
+* never is if there's room for MAX_COPY past `limit'
+* @return int Position in `dst' after the last decoded byte
+*/
+int PKWareInputStream::decodeTokens(unsigned char *dst, int pos, int limit, int capacity) {
+	if (limit > capacity) {
+		limit = capacity;
+	}
+	while (pos < limit) {
+		if (readBit() == 0) {
+			// Copy byte verbatim
+			int result = readBits(8);
+			if (status != PK_OK) {
+				break;
+			}
+			dst[pos++] = (unsigned char)result;
+			continue;
+		}
+		int length = getCopyLength();
+		if (status != PK_OK) {
+			break;
+		}
+		if (length >= 519) {
+			status = PK_END_OF_STREAM;
+			break;
+		}
+		int offset = getCopyOffset(length) + 1;
+		if (status != PK_OK) {
+			break;
+		}
+		if (offset > pos) {
+			fail(PK_CORRUPT, "Invalid copy offset");
+			break;
+		}
+		if (length > capacity - pos) {
+			length = capacity - pos;
+		}
+		copyMatch(dst + pos, offset, length);
+		pos += length;
+	}
+	return pos;
+}
+
+/**
+* Decodes the next part of the stream into the window, for reading
+* when the decompressed length isn't known up front. When the window is
+* full, its last bytes are moved to the front first: those are all the
+* dictionary copies can refer to.
+* @return bool False if more input has to be fed before anything can
+* be decoded, only in push mode
+*/
+bool PKWareInputStream::fillWindow() {
+	if (win_end >= WINDOW_SIZE - MAX_COPY) {
+		memmove(window, window + win_end - MAX_DICT_SIZE, MAX_DICT_SIZE);
+		win_pos = win_end = MAX_DICT_SIZE;
+	}
+	if (!pushing) {
+		win_end = decodeTokens(window, win_end, WINDOW_SIZE - MAX_COPY, WINDOW_SIZE);
+		return true;
+	}
+	
+	// Pushed input may stop anywhere, so only start on a token once all
+	// of its bits are there; that way nothing needs to be undone
+	if (header_bytes < 2) {
+		return false;
+	}
+	int pos = win_end;
+	while (pos < WINDOW_SIZE - MAX_COPY && status == PK_OK) {
+		refillBits();
+		if (bitCount < MAX_TOKEN_BITS && !eof_reached) {
+			break;
+		}
+		pos = decodeTokens(window, pos, pos + 1, WINDOW_SIZE);
+	}
+	bool progress = (pos > win_end || status != PK_OK);
+	win_end = pos;
+	return progress;
 }
 
 /**
 * Gets the amount of bytes to copy from the dictionary
 */
 int PKWareInputStream::getCopyLength() {
+#ifndef PKWARE_BRANCHY_DECODER
+	const PKHuffmanTables::LengthCode &code = huffman.length[peekByte()];
+	dropBits(code.bits);
+	if (code.extra) {
+		return code.base + readBits(code.extra);
+	}
+	return code.base;
+#else
 	int bits;
 	
 	bits = readBits(2);
@@ -361,7 +764,9 @@ int PKWareInputStream::getCopyLength() {
 			}
 		}
 	}
-	throw PKException("Invalid copy length");
+	fail(PK_CORRUPT, "Invalid copy length");
+	return 0;
+#endif
 }
 
 /**
@@ -386,6 +791,11 @@ int PKWareInputStream::getCopyOffset(int length) {
 * dictionary size.
 */
 int PKWareInputStream::getCopyOffsetHigh() {
+#ifndef PKWARE_BRANCHY_DECODER
+	const PKHuffmanTables::OffsetCode &code = huffman.offset[peekByte()];
+	dropBits(code.bits);
+	return code.value;
+#else
 	int bits;
 	
 	bits = readBits(2);
@@ -427,7 +837,9 @@ int PKWareInputStream::getCopyOffsetHigh() {
 		}
 	}
 	
-	throw PKException("Invalid copy offset");
+	fail(PK_CORRUPT, "Invalid copy offset");
+	return 0;
+#endif
 }
 
 /**
@@ -445,45 +857,86 @@ int PKWareInputStream::reverse(int number, int length) {
 	return result;
 }
 
+/**
+* Moves the input stream to the end of the compressed block, skipping
+* whatever part of it hasn't been buffered yet
+*/
+void PKWareInputStream::skipInput() {
+	if (input && !eof_reached) {
+		if (file_length > 0) {
+			input->seekg(file_length, ios::cur);
+		}
+		file_length = 0;
+		eof_reached = true;
+	}
+}
+
 /**
 * Fill the internal buffer
 */
 void PKWareInputStream::fillBuffer() {
-	bufOffset = 0;
-	if (file_length <= BUFFER_SIZE) {
-		input->read(buffer, file_length);
+	int count = (file_length <= BUFFER_SIZE) ? file_length : BUFFER_SIZE;
+	input->read(buffer, count);
+	file_length -= count;
+	if (file_length == 0) {
+		eof_reached = true;
+	}
+	inPos = (const unsigned char *)buffer;
+	inEnd = inPos + input->gcount();
+	if (inPos == inEnd) {
+		// Stream ended before the compressed block did
 		eof_reached = true;
-		eof_position = file_length;
-	} else {
-		input->read(buffer, BUFFER_SIZE);
-		file_length -= BUFFER_SIZE;
 	}
 }
 
 /**
-* Advances the data pointer one byte, filling the buffer
-* if necessary
+* Tops up the bit buffer with whole bytes until it holds more than 56
+* bits, filling the internal buffer if necessary. Bounds are checked
+* once per run of bytes rather than once per byte.
 */
-void PKWareInputStream::advanceByte() {
-	bufOffset++;
-	if (eof_reached && bufOffset >= eof_position) {
-		throw PKException("EOF (invalid)");
+void PKWareInputStream::refillBits() {
+	while (bitCount <= 56) {
+		if (inPos >= inEnd) {
+			if (eof_reached || !input) {
+				return;
+			}
+			fillBuffer();
+		}
+		int count = (64 - bitCount) >> 3;
+		if (count > inEnd - inPos) {
+			count = (int)(inEnd - inPos);
+		}
+		for (int i = 0; i < count; i++) {
+			bitBuffer |= (unsigned long long)inPos[i] << bitCount;
+			bitCount += 8;
+		}
+		inPos += count;
 	}
-	if (bufOffset >= BUFFER_SIZE) {
-		fillBuffer();
+}
+
+/**
+* Makes sure the bit buffer holds at least `length' bits. If the input
+* has run out, the missing bits read as zeroes and the stream is marked
+* as truncated.
+*/
+inline void PKWareInputStream::needBits(int length) {
+	if (bitCount < length) {
+		refillBits();
+		if (bitCount < length) {
+			fail(PK_TRUNCATED, "EOF (invalid)");
+			bitCount = 64;
+		}
 	}
-	bufBit = 0;
 }
 
 /**
 * Reads one single bit
 */
 unsigned char PKWareInputStream::readBit() {
-	if (bufBit == 8) {
-		advanceByte();
-	}
-	unsigned char b = (unsigned char)((buffer[bufOffset] & (1 << bufBit)) >> bufBit);
-	bufBit++;
+	needBits(1);
+	unsigned char b = (unsigned char)(bitBuffer & 1);
+	bitBuffer >>= 1;
+	bitCount--;
 	return b;
 }
 
@@ -493,26 +946,34 @@ unsigned char PKWareInputStream::readBit() {
 * @return int Value of the bits read
 */
 int PKWareInputStream::readBits(int length) {
-	int result;
-	if (bufBit == 8) {
-		advanceByte();
-	}
-	// Check to see if we span multiple bytes
-	if (bufBit + length > 8) {
-		// First take last remaining bits in this byte & put them in place
-		result = ((buffer[bufOffset] & 0xff) >> bufBit);
-		int length2 = length + bufBit - 8;
-		int length1 = length - length2;
-		advanceByte();
-		
-		// Read length2 bytes from the second byte & add them to the result
-		result |= ((buffer[bufOffset]) & ((1 << length2) - 1)) << length1;
-		bufBit = length2;
-	} else {
-		// Same byte, easy!
-		result = buffer[bufOffset] >> bufBit;
-		result &= (1 << length) - 1;
-		bufBit += length;
-	}
+	needBits(length);
+	int result = (int)(bitBuffer & ((1 << length) - 1));
+	bitBuffer >>= length;
+	bitCount -= length;
 	return result;
 }
+
+/**
+* Returns the next 8 bits without consuming them, for the table lookups.
+* At the end of the stream the missing bits read as zeroes; dropBits()
+* catches codes that would run past the end.
+*/
+int PKWareInputStream::peekByte() {
+	if (bitCount < 8) {
+		refillBits();
+	}
+	return (int)(bitBuffer & 0xff);
+}
+
+/**
+* Consumes bits that were looked at with peekByte()
+* @param length Number of bits to drop, never more than 8
+*/
+void PKWareInputStream::dropBits(int length) {
+	if (bitCount < length) {
+		fail(PK_TRUNCATED, "EOF (invalid)");
+		bitCount = 64;
+	}
+	bitBuffer >>= length;
+	bitCount -= length;
+}
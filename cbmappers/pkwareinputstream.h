@@ -21,6 +21,7 @@
 
 #include <string>
 #include <istream>
+#include <vector>
 
 /**
 * Exception class for errors
@@ -34,17 +35,51 @@ class PKException {
 };
 
 /**
-* Internal class
+* Result of the decoding methods that report errors through their
+* return value instead of throwing exceptions
 */
-class PKDictionary;
+enum PKStatus {
+	PK_OK, // all requested data has been decoded
+	PK_END_OF_STREAM, // the end marker of the compressed data was reached
+	PK_CORRUPT, // the compressed data is invalid
+	PK_TRUNCATED, // the compressed data ends before its end marker
+	PK_NEED_INPUT // push mode only: feed() more data to continue
+};
+
+/**
+* Decoder state at the start of a literal or copy, from which a block
+* in memory can be decoded without decoding everything before it.
+* @see PKWareInputStream::decompress(unsigned char *, int, int, std::vector<PKCheckpoint> *, int *)
+*/
+typedef struct {
+	int output_offset; // position in the decompressed data
+	int bit_offset; // position in the compressed data, in bits
+	int window_length; // decompressed bytes in `window', at most 4096
+	unsigned char window[4096]; // decompressed data just before output_offset
+} PKCheckpoint;
 
 /**
 * Input class for reading files / blocks of data compressed with the
 * PKWare Compression Library.
-* All methods (including constructors) may throw a PKException
+* All methods (including constructors) may throw a PKException, except
+* reset(), feed(), finish(), decode(), decompress() and decompressChunk(),
+* which report errors through a PKStatus instead.
+*
+* Besides reading from a file, stream or memory block, the decoder can
+* also take compressed data as it arrives, e.g. from a pipe: reset()
+* it, feed() each slice and decode() until that returns PK_NEED_INPUT,
+* then finish() once the data ends and decode() what is left.
 */
 class PKWareInputStream {
 	public:
+		/**
+		* Constructor for a decoder without any data yet. Use reset() to
+		* give it some. A decoder can be reset() any number of times;
+		* it only allocates memory when decompressing into an output
+		* buffer larger than any one before.
+		*/
+		PKWareInputStream();
+		
 		/**
 		* Constructor
 		* @param filename Name of the file to open
@@ -62,10 +97,79 @@ class PKWareInputStream {
 		* @param file_length Length of the compressed data. If not given, the
 		* object tries to figure it out, but may read beyond the end of the
 		* compressed block
+		* @param output_length Length of the decompressed data, if known.
+		* The whole block is then decompressed up front into a buffer of
+		* this size, which also serves as the dictionary; reading beyond
+		* it reports EOF. Afterwards the stream is positioned right after
+		* the compressed block.
 		*/
-		PKWareInputStream(std::istream *i, bool close_stream = true, int file_length = -1);
+		PKWareInputStream(std::istream *i, bool close_stream = true,
+			int file_length = -1, int output_length = -1);
+		
+		/**
+		* Constructor. Reads the compressed data straight from memory,
+		* e.g. from a MappedFile. `data' must stay valid for as long as
+		* this object is in use, unless `output_length' is given.
+		* @param data Compressed data, including the 2-byte header
+		* @param length Length of the compressed data
+		* @param output_length Length of the decompressed data, if known.
+		* @see PKWareInputStream(std::istream *, bool, int, int)
+		*/
+		PKWareInputStream(const unsigned char *data, int length,
+			int output_length = -1);
 		~PKWareInputStream();
 		
+		/**
+		* Starts decoding a new block of compressed data from memory,
+		* forgetting about the previous one
+		* @see PKWareInputStream(const unsigned char *, int, int)
+		*/
+		PKStatus reset(const unsigned char *data, int length,
+			int output_length = -1);
+		
+		/**
+		* Starts decoding a new block whose compressed data will be
+		* passed in slice by slice with feed()
+		*/
+		void reset();
+		
+		/**
+		* Passes in the next slice of compressed data, in push mode. The
+		* data must stay valid until decode() returns PK_NEED_INPUT,
+		* which means all of it has been used up.
+		*/
+		void feed(const unsigned char *data, int length);
+		
+		/**
+		* Tells the decoder no more data will be fed, in push mode.
+		* Afterwards decode() reports PK_TRUNCATED rather than
+		* PK_NEED_INPUT if the data stops before its end marker.
+		*/
+		void finish();
+		
+		/**
+		* Starts decoding a block from memory at a checkpoint recorded
+		* for it. Reading continues at checkpoint->output_offset.
+		*/
+		PKStatus reset(const unsigned char *data, int length,
+			const PKCheckpoint *checkpoint);
+		
+		/**
+		* Decompresses the whole block into `dst'. Only works right after
+		* construction or reset() without an output length, before
+		* anything has been read.
+		* @see decompressChunk(const unsigned char *, int, unsigned char *, int, int *)
+		*/
+		PKStatus decompress(unsigned char *dst, int capacity, int *written = NULL);
+		
+		/**
+		* Same as decompress(), but also adds a checkpoint to
+		* `checkpoints' at the start and about every `interval' bytes
+		* of output. Only works for blocks in memory.
+		*/
+		PKStatus decompress(unsigned char *dst, int capacity, int interval,
+			std::vector<PKCheckpoint> *checkpoints, int *written = NULL);
+		
 		/**
 		* Reads a single byte from the compressed stream
 		*/
@@ -80,6 +184,16 @@ class PKWareInputStream {
 		*/
 		int read(unsigned char *buf, int length);
 		
+		/**
+		* Reads a block of data without throwing exceptions
+		* @param buf Place to put read data, or NULL to discard it
+		* @param length Maximum length to read
+		* @param count Set to the number of bytes actually read
+		* @return PKStatus PK_OK if `length' bytes have been read, otherwise
+		* the reason why fewer were read
+		*/
+		PKStatus decode(unsigned char *buf, int length, int *count);
+		
 		/**
 		* Reads a byte from the input stream. Same as read()
 		*/
@@ -105,38 +219,113 @@ class PKWareInputStream {
 		*/
 		void empty();
 		
+		/**
+		* Decompresses a whole chunk in one go
+		* @param src Compressed data, including the 2-byte header
+		* @param length Length of the compressed data
+		* @param dst Place to put the decompressed data
+		* @param capacity Size of `dst'. Decompression stops once `dst' is
+		* full, even if the chunk holds more data
+		* @param written If not NULL, set to the number of bytes written
+		* to `dst'
+		* @return PKStatus PK_OK if `dst' has been filled, PK_END_OF_STREAM
+		* if the chunk ended before that, or the error encountered
+		*/
+		static PKStatus decompressChunk(const unsigned char *src, int length,
+			unsigned char *dst, int capacity, int *written = NULL);
+		
+		/**
+		* Decompresses a whole chunk of `length' bytes read from `input'.
+		* Afterwards the stream is positioned right after the chunk.
+		* @see decompressChunk(const unsigned char *, int, unsigned char *, int, int *)
+		*/
+		static PKStatus decompressChunk(std::istream *input, int length,
+			unsigned char *dst, int capacity, int *written = NULL);
+		
+		/**
+		* Decompresses the blocks of `count' decoders at once in the
+		* calling thread, decoding a bit of each in turn. Works like
+		* calling decompress() on each; the blocks don't depend on each
+		* other, so an out-of-order processor can overlap their work.
+		* Only pays off with three or four blocks of similar size.
+		* @param count Number of decoders, at most MAX_INTERLEAVE
+		* @param status Set to the result for each decoder
+		* @param written If not NULL, set to the number of bytes written
+		* for each decoder
+		*/
+		static void decompress(int count, PKWareInputStream **decoders,
+			unsigned char **dst, const int *capacity, PKStatus *status,
+			int *written = NULL);
+		
+		static const int MAX_INTERLEAVE = 4;
+		
 	private:
-		void init();
-		void readHeader();
+		void init(int output_length);
+		PKStatus start(int output_length);
+		void fail(PKStatus error_status, const char *message);
+		PKStatus readHeader();
+		PKStatus parseHeader(const char *header);
+		int decodeTokens(unsigned char *dst, int pos, int limit, int capacity);
+		bool fillWindow();
 		int getCopyLength();
 		int getCopyOffset(int length);
 		int getCopyOffsetHigh();
 		int reverse(int number, int length);
+		void skipInput();
 		void fillBuffer();
-		void advanceByte();
+		void refillBits();
+		void needBits(int length);
 		unsigned char readBit();
 		int readBits(int length);
+		int peekByte();
+		void dropBits(int length);
+		
+		static const int
+			BUFFER_SIZE = 4096,
+			MAX_DICT_SIZE = 4096,
+			MAX_COPY = 518, // longest copy from the dictionary
+			MAX_TOKEN_BITS = 30, // longest literal or copy code
+			STEP = 128, // bytes to decode per block per turn when interleaving
+			WINDOW_SIZE = 32768;
 		
 		// Class variables (comments is where they're initialised)
-		std::istream *input; // ctor
+		std::istream *input; // ctor or reset
 		int dictSize; // readHeader
-		char *buffer; // fillBuffer
-		int bufOffset; // fillBuffer
-		int bufBit; // init
+		char buffer[BUFFER_SIZE]; // fillBuffer
+		const unsigned char *inStart; // init, memory blocks only
+		const unsigned char *inPos; // ctor or fillBuffer
+		const unsigned char *inEnd; // ctor or fillBuffer
+		unsigned long long bitBuffer; // init, refillBits
+		int bitCount; // init, refillBits
 		int dictionary_bits; // readHeader
-		PKDictionary *dictionary; // readHeader
 		
-		// For the reading of bytes:
-		int read_offset; // init
-		int read_length; // init
-		bool read_copying; // init
-		int file_length; // ctor or init
+		// For decompressing into an output buffer at once:
+		unsigned char *out_buffer; // ctor, init
+		int out_capacity; // ctor, init
+		unsigned char *output; // init
+		int out_offset; // init
+		int out_length; // init
+		
+		// For the reading of bytes when the decompressed length is unknown:
+		// the window holds the dictionary followed by decoded bytes that
+		// haven't been read yet
+		unsigned char window[WINDOW_SIZE]; // fillWindow
+		int win_pos; // init, decode
+		int win_end; // init, fillWindow
+		int file_length; // ctor, reset or init
+		
+		// For input that is pushed in with feed():
+		bool pushing; // init, reset
+		char header[2]; // feed
+		int header_bytes; // reset, feed
 		
 		// For detecting end of stream:
 		bool eof_reached; // init, fillBuffer
-		int eof_position; // fillBuffer
 		bool close_stream; // ctor
-		static const int BUFFER_SIZE = 4096;
+		
+		// Error reporting:
+		PKStatus status; // init, fail
+		const char *error; // init, fail
 };
 
 #endif /* pkwareinputstream_h */
@@ -20,21 +20,40 @@
 #define pngimage_h
 
 #include <string>
-#include <set>
+#include "indexedpngimage.h"
 
-class PNGImage {
+/**
+* Palette image that is drawn with RGB colours; the palette is built up
+* from the colours used
+*/
+class PNGImage : public IndexedPNGImage {
 	public:
-		PNGImage(int width, int height, int bitdepth = 8);
-		~PNGImage();
+		/**
+		* Constructor
+		* @param bitdepth 1, 2, 4 or 8; allows up to 2^bitdepth colours.
+		* The file gets the smallest bit depth for the colours used.
+		* @param arena Arena for the pixels and the buffers of write(),
+		* or NULL to use the heap
+		*/
+		PNGImage(int width, int height, int bitdepth = 8, Arena *arena = NULL);
+		
+		/**
+		* Sets pixel (x, y) to the given colour
+		* @throws const char* if the image would get more colours than
+		* the bit depth allows
+		*/
 		void setRGB(int x, int y, int color);
 		void setRGB(int x, int y, int r, int g, int b);
-		bool write(std::string filename);
 	private:
-		int width;
-		int height;
-		int bitdepth;
-		int **image;
-		std::set<int> colours;
+		int getIndex(int color);
+		
+		static const int HASH_SIZE = 512; // power of two, at most half full
+		
+		// Open addressing table from colour to palette index; empty
+		// slots hold -1, which is no RGB colour
+		int hash_colour[HASH_SIZE];
+		unsigned char hash_index[HASH_SIZE];
+		int max_colours;
 };
 
 #endif /* pngimage_h */
@@ -0,0 +1,151 @@
+#include "pngwriter.h"
+#include <zlib.h>
+#include <iostream>
+using namespace std;
+
+// Filters only make these images larger. Z_RLE would be quicker still,
+// but two colours per tile leave few long runs and the files grow by 3/4
+const PNGCompression
+	PNGWriter::FAST     = {1, Z_DEFAULT_STRATEGY, PNG_FILTER_NONE},
+	PNGWriter::BALANCED = {6, Z_DEFAULT_STRATEGY, PNG_FILTER_NONE},
+	PNGWriter::SMALLEST = {9, Z_DEFAULT_STRATEGY, PNG_FILTER_NONE};
+
+bool PNGWriter::preset(std::string name, PNGCompression *compression) {
+	if (name == "fast") {
+		*compression = FAST;
+	} else if (name == "balanced") {
+		*compression = BALANCED;
+	} else if (name == "smallest") {
+		*compression = SMALLEST;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+PNGWriter::PNGWriter(Arena *arena) {
+	this->arena = arena;
+	fp = NULL;
+	png_ptr = NULL;
+	info_ptr = NULL;
+}
+
+PNGWriter::~PNGWriter() {
+	cleanup();
+}
+
+/**
+* Memory functions that let libpng and zlib take their buffers from an
+* arena. libpng can't handle exceptions, so running out gives NULL.
+*/
+static png_voidp arenaMalloc(png_structp png_ptr, png_size_t size) {
+	try {
+		return ((Arena *)png_get_mem_ptr(png_ptr))->allocate(size);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+static void arenaFree(png_structp, png_voidp) {
+	// The arena frees everything at once
+}
+
+bool PNGWriter::open(std::string filename, int width, int height,
+		const int *palette, int num_colours, const PNGCompression &compression) {
+	cleanup();
+	fp = fopen(filename.c_str(), "wb");
+	if (fp == NULL) {
+		cerr << "PNGWriter::open: fopen() returned NULL" << endl;
+		return false;
+	}
+	
+	if (arena) {
+		png_ptr = png_create_write_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL,
+			arena, arenaMalloc, arenaFree);
+	} else {
+		png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	}
+	if (png_ptr) {
+		info_ptr = png_create_info_struct(png_ptr);
+	}
+	// Every function calling libpng needs its own setjmp, as libpng
+	// jumps back to the last one on errors
+	if (!png_ptr || !info_ptr || setjmp(png_jmpbuf(png_ptr))) {
+		cerr << "PNGWriter::open: libpng error" << endl;
+		cleanup();
+		return false;
+	}
+	
+	png_color pal[256];
+	for (int i = 0; i < num_colours; i++) {
+		pal[i].red = palette[i] >> 16;
+		pal[i].green = (palette[i] >> 8) & 0xff;
+		pal[i].blue = palette[i] & 0xff;
+	}
+	
+	png_init_io(png_ptr, fp);
+	png_set_compression_level(png_ptr, compression.level);
+	png_set_compression_strategy(png_ptr, compression.strategy);
+	png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, compression.filters);
+	
+	// Use the smallest bit depth that fits the palette
+	int bitdepth = 8;
+	if (num_colours <= 2) {
+		bitdepth = 1;
+	} else if (num_colours <= 4) {
+		bitdepth = 2;
+	} else if (num_colours <= 16) {
+		bitdepth = 4;
+	}
+	png_set_IHDR(png_ptr, info_ptr, width, height,
+		bitdepth, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+		PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_set_PLTE(png_ptr, info_ptr, pal, num_colours);
+	png_write_info(png_ptr, info_ptr);
+	if (bitdepth < 8) {
+		// Rows still come in one index per byte; libpng packs them
+		png_set_packing(png_ptr);
+	}
+	return true;
+}
+
+bool PNGWriter::writeRow(const unsigned char *row) {
+	if (!png_ptr) {
+		return false;
+	}
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		cerr << "PNGWriter::writeRow: libpng error" << endl;
+		cleanup();
+		return false;
+	}
+	png_write_row(png_ptr, row);
+	return true;
+}
+
+bool PNGWriter::close() {
+	if (!png_ptr) {
+		return false;
+	}
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		cerr << "PNGWriter::close: libpng error" << endl;
+		cleanup();
+		return false;
+	}
+	png_write_end(png_ptr, info_ptr);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	int result = fclose(fp);
+	fp = NULL;
+	return result == 0;
+}
+
+void PNGWriter::cleanup() {
+	if (png_ptr) {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+	}
+	if (fp) {
+		fclose(fp);
+		fp = NULL;
+	}
+	png_ptr = NULL;
+	info_ptr = NULL;
+}
@@ -0,0 +1,110 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef pngwriter_h
+#define pngwriter_h
+
+#include <string>
+#include <stdio.h>
+#include <png.h>
+#include "arena.h"
+
+/**
+* How the image data is compressed
+*/
+typedef struct {
+	int level;    // zlib level, 0 (none) to 9 (smallest)
+	int strategy; // zlib strategy: Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE, ...
+	int filters;  // PNG filters to try: PNG_FILTER_NONE, PNG_ALL_FILTERS, ...
+} PNGCompression;
+
+/**
+* Writes a palette PNG file one row at a time, so the caller never
+* needs the whole image in the output format. Rows go to libpng as
+* soon as they are written and are compressed while the caller works
+* on the next one. The file gets the smallest bit depth that holds the
+* palette: 1, 2, 4 or 8 bits per pixel.
+*/
+class PNGWriter {
+	public:
+		/**
+		* Constructor
+		* @param arena Arena for the buffers of libpng and zlib, or NULL
+		* to use the heap
+		*/
+		PNGWriter(Arena *arena = NULL);
+		
+		/**
+		* Compression presets:
+		* FAST     - quickest to write, a little larger
+		* BALANCED - the libpng defaults
+		* SMALLEST - smallest files, slowest to write
+		*/
+		static const PNGCompression FAST, BALANCED, SMALLEST;
+		
+		/**
+		* Looks up a preset by its name: "fast", "balanced" or "smallest"
+		* @return bool Whether `name' is a preset
+		*/
+		static bool preset(std::string name, PNGCompression *compression);
+		
+		/**
+		* Destructor. Closes the file if close() wasn't called; the file
+		* is incomplete then.
+		*/
+		~PNGWriter();
+		
+		/**
+		* Creates the file and writes the header
+		* @param palette Colours as 0xRRGGBB
+		* @param num_colours Number of colours in palette, 1 to 256
+		* @param compression How to compress the image data
+		* @return bool Whether it worked
+		*/
+		bool open(std::string filename, int width, int height,
+			const int *palette, int num_colours,
+			const PNGCompression &compression = BALANCED);
+		
+		/**
+		* Writes the next row, top to bottom
+		* @param row `width' palette indices, one byte each whatever the
+		* bit depth of the file
+		* @return bool Whether it worked
+		*/
+		bool writeRow(const unsigned char *row);
+		
+		/**
+		* Finishes the file after all rows are written
+		* @return bool Whether the whole file was written
+		*/
+		bool close();
+	
+	private:
+		void cleanup();
+		
+		// Copying would close the file twice
+		PNGWriter(const PNGWriter &);
+		PNGWriter &operator=(const PNGWriter &);
+		
+		Arena *arena;
+		FILE *fp;
+		png_structp png_ptr;
+		png_infop info_ptr;
+};
+
+#endif /* pngwriter_h */
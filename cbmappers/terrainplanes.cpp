@@ -0,0 +1,136 @@
+/*
+ *   ZeusMapper - create minimaps from Zeus scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "terrainplanes.h"
+#include <string.h>
+
+TerrainPlanes::TerrainPlanes(const MapGrid<unsigned int> &terrain)
+	: terrain(terrain) {
+	num_words = (terrain.tiles() + 63) / 64;
+	memory = new unsigned long long[PLANES * num_words];
+	memset(memory, 0, PLANES * num_words * sizeof(unsigned long long));
+	for (int b = 0; b < PLANES; b++) {
+		planes[b] = memory + b * num_words;
+	}
+	
+	// Tiles are stored row after row, so go through the rows in order
+	used = 0;
+	int tile = 0;
+	for (int y = 0; y < terrain.height(); y++) {
+		const unsigned int *row = terrain.row(y);
+		int length = terrain.end(y) - terrain.begin(y);
+		for (int x = 0; x < length; x++, tile++) {
+			unsigned int flags = row[x];
+			used |= flags;
+			while (flags) {
+				int b = __builtin_ctz(flags);
+				planes[b][tile >> 6] |= 1ULL << (tile & 63);
+				flags &= flags - 1;
+			}
+		}
+	}
+}
+
+TerrainPlanes::~TerrainPlanes() {
+	delete[] memory;
+}
+
+/**
+* Returns word `word' of the union of the planes in `mask'
+*/
+unsigned long long TerrainPlanes::combine(unsigned int mask, int word) const {
+	unsigned long long bits = 0;
+	while (mask) {
+		bits |= planes[__builtin_ctz(mask)][word];
+		mask &= mask - 1;
+	}
+	return bits;
+}
+
+int TerrainPlanes::count(unsigned int mask) const {
+	mask &= used;
+	if (!mask) {
+		return 0;
+	}
+	int total = 0;
+	if (!(mask & (mask - 1))) {
+		// Just one flag: count its plane directly
+		const unsigned long long *p = planes[__builtin_ctz(mask)];
+		for (int i = 0; i < num_words; i++) {
+			total += __builtin_popcountll(p[i]);
+		}
+		return total;
+	}
+	for (int i = 0; i < num_words; i++) {
+		total += __builtin_popcountll(combine(mask, i));
+	}
+	return total;
+}
+
+int TerrainPlanes::countAll(unsigned int mask) const {
+	if (!mask || (mask & used) != mask) {
+		return mask ? 0 : terrain.tiles();
+	}
+	int total = 0;
+	for (int i = 0; i < num_words; i++) {
+		unsigned long long bits = ~0ULL;
+		for (unsigned int m = mask; m; m &= m - 1) {
+			bits &= planes[__builtin_ctz(m)][i];
+		}
+		total += __builtin_popcountll(bits);
+	}
+	return total;
+}
+
+bool TerrainPlanes::any(unsigned int mask) const {
+	return (mask & used) != 0;
+}
+
+int TerrainPlanes::count(unsigned int mask, int x1, int y1, int x2, int y2) const {
+	mask &= used;
+	if (!mask) {
+		return 0;
+	}
+	if (y1 < 0) y1 = 0;
+	if (y2 > terrain.height()) y2 = terrain.height();
+	
+	int total = 0;
+	for (int y = y1; y < y2; y++) {
+		// Part of this row inside the rectangle, as tile numbers
+		int from = (x1 > terrain.begin(y)) ? x1 : terrain.begin(y);
+		int to = (x2 < terrain.end(y)) ? x2 : terrain.end(y);
+		if (from >= to) {
+			continue;
+		}
+		int first = terrain.index(from, y);
+		int last = terrain.index(to - 1, y) + 1;
+		
+		// Count whole words, masking off the tiles outside the range
+		for (int w = first >> 6; w <= (last - 1) >> 6; w++) {
+			unsigned long long bits = combine(mask, w);
+			if (w == first >> 6) {
+				bits &= ~0ULL << (first & 63);
+			}
+			if (w == (last - 1) >> 6 && (last & 63)) {
+				bits &= ~0ULL >> (64 - (last & 63));
+			}
+			total += __builtin_popcountll(bits);
+		}
+	}
+	return total;
+}
@@ -0,0 +1,94 @@
+/*
+ *   ZeusMapper - create minimaps from Zeus scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef terrainplanes_h
+#define terrainplanes_h
+
+#include "mapgrid.h"
+
+/**
+* The terrain layer split into bit planes: for every terrain flag, one
+* bit per tile that is set if the tile has that flag. Counting the
+* tiles with some combination of flags then works on 64 tiles at a
+* time, without looking at the tiles one by one.
+* Tiles are numbered as in the MapGrid the planes are built from.
+*/
+class TerrainPlanes {
+	public:
+		/**
+		* Builds the planes from a terrain layer in one pass
+		* @param terrain Terrain flags of each tile
+		*/
+		TerrainPlanes(const MapGrid<unsigned int> &terrain);
+		~TerrainPlanes();
+		
+		/**
+		* Returns the number of tiles that have at least one of the
+		* flags in `mask'
+		*/
+		int count(unsigned int mask) const;
+		
+		/**
+		* Returns the number of tiles that have all of the flags in `mask'
+		*/
+		int countAll(unsigned int mask) const;
+		
+		/**
+		* Returns whether any tile has one of the flags in `mask'
+		*/
+		bool any(unsigned int mask) const;
+		
+		/**
+		* Returns the number of tiles inside a rectangle that have at
+		* least one of the flags in `mask'. The rectangle may extend
+		* past the map.
+		* @param x1 Left side
+		* @param y1 Top side
+		* @param x2 Right side, not included
+		* @param y2 Bottom side, not included
+		*/
+		int count(unsigned int mask, int x1, int y1, int x2, int y2) const;
+		
+		/**
+		* Returns the bit plane of flag `bit' (0-31); tile i is bit
+		* i % 64 of word i / 64
+		*/
+		const unsigned long long *plane(int bit) const { return planes[bit]; }
+		
+		/**
+		* Returns the number of 64-bit words in each plane
+		*/
+		int words() const { return num_words; }
+		
+	private:
+		// Copying would free the memory twice
+		TerrainPlanes(const TerrainPlanes &);
+		TerrainPlanes &operator=(const TerrainPlanes &);
+		
+		unsigned long long combine(unsigned int mask, int word) const;
+		
+		static const int PLANES = 32;
+		
+		const MapGrid<unsigned int> &terrain;
+		int num_words;
+		unsigned long long *memory;
+		unsigned long long *planes[PLANES];
+		unsigned int used; // flags that occur at least once
+};
+
+#endif /* terrainplanes_h */
@@ -0,0 +1,106 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <string.h>
+#include "chunkdecoder.h"
+#include "testutil.h"
+
+using namespace std;
+
+/**
+* Queues all test files at once in a ChunkDecoder and checks that run()
+* only succeeds when every chunk fills its full size: chunks asked for
+* their exact size or less must decode to the start of the .raw file,
+* chunks asked for more than the stream holds, or cut off, must make
+* run() fail. Each batch is run with one and with several threads.
+* Usage: chunkdecodertest file.pk...
+*/
+
+static const int VARIANTS = 4;
+
+/**
+* Size to ask for and compressed length to give for `variant' of a
+* file with `length' compressed and `size' decompressed bytes
+* @return bool Whether the chunk can fill the size asked for
+*/
+static bool chunkFor(int variant, int length, int size, int *chunk_length, int *chunk_size) {
+	*chunk_length = length;
+	*chunk_size = size;
+	switch (variant) {
+		case 0: return true;
+		case 1: *chunk_size = size / 2; return true;
+		case 2: *chunk_size = size + 1; return false; // too short
+		case 3: // cut off after the header
+			*chunk_length = 2;
+			return false;
+	}
+	return false;
+}
+
+/**
+* Decodes one batch: variant `bad' for file `bad_file' and the exact
+* size for all others, or the exact size for all if `bad_file' is -1
+*/
+static void runBatch(const vector<vector<unsigned char> > &pk,
+		const vector<vector<unsigned char> > &raw, int threads, int bad_file, int variant) {
+	ChunkDecoder chunks(threads);
+	vector<int> indices(pk.size());
+	bool expected = true;
+	for (unsigned int i = 0; i < pk.size(); i++) {
+		int length, size;
+		bool full = chunkFor((int)i == bad_file ? variant : 0, pk[i].size(), raw[i].size(), &length, &size);
+		expected = expected && full;
+		indices[i] = chunks.add(pk[i].data(), length, size);
+	}
+	CHECK(chunks.run() == expected);
+	
+	for (unsigned int i = 0; i < pk.size(); i++) {
+		int length, size;
+		bool full = chunkFor((int)i == bad_file ? variant : 0, pk[i].size(), raw[i].size(), &length, &size);
+		if (full) {
+			CHECK(chunks.written(indices[i]) == size);
+			CHECK(size == 0 || memcmp(chunks.data(indices[i]), raw[i].data(), size) == 0);
+		} else {
+			CHECK(chunks.written(indices[i]) < size || chunks.status(indices[i]) == PK_TRUNCATED);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	vector<vector<unsigned char> > pk(argc - 1);
+	vector<vector<unsigned char> > raw(argc - 1);
+	for (int arg = 1; arg < argc; arg++) {
+		pk[arg - 1] = readTestFile(argv[arg]);
+		raw[arg - 1] = readTestFile(rawName(argv[arg]));
+	}
+	
+	int cases = 0;
+	for (int threads = 1; threads <= 4; threads += 3) {
+		test_file = "all files";
+		runBatch(pk, raw, threads, -1, 0);
+		cases++;
+		for (int file = 0; file < argc - 1; file++) {
+			test_file = argv[file + 1];
+			for (int variant = 1; variant < VARIANTS; variant++) {
+				runBatch(pk, raw, threads, file, variant);
+				cases++;
+			}
+		}
+	}
+	return testResult("chunkdecodertest", cases);
+}
@@ -0,0 +1,138 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <fstream>
+#include "testutil.h"
+
+using namespace std;
+
+/**
+* Leak check: converts the sample files, and copies of them cut in half
+* that make the parsers give up halfway, over and over in one process
+* through the main() of each mapper. Once every file has been seen, the
+* memory the process uses must stay flat.
+* The mappers are linked in with their main() renamed, see the Makefile.
+* Usage: leakcheck rounds file...
+*/
+
+int c3_main(int argc, char **argv);
+int pharaoh_main(int argc, char **argv);
+int zeus_main(int argc, char **argv);
+
+static const char OUTPUT_FILE[] = "tests/leakcheck.tmp.png";
+static const long MAX_GROWTH = 512; // KB
+
+/**
+* Returns the resident set size of the process in KB
+*/
+static long residentKB() {
+	ifstream statm("/proc/self/statm");
+	long size = 0, resident = 0;
+	statm >> size >> resident;
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+* A file to convert, and the mapper to convert it with
+*/
+typedef struct {
+	string filename;
+	int (*convert)(int, char **);
+	bool valid;
+} Sample;
+
+/**
+* Converts each sample once, checking the result
+*/
+static void convertAll(const vector<Sample> &samples) {
+	for (unsigned int i = 0; i < samples.size(); i++) {
+		test_file = samples[i].filename.c_str();
+		char *args[] = {(char *)"mapper", (char *)samples[i].filename.c_str(),
+			(char *)OUTPUT_FILE, NULL};
+		int result = samples[i].convert(3, args);
+		CHECK(samples[i].valid ? result == 0 : result != 0);
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		fprintf(stderr, "Usage: leakcheck rounds file...\n");
+		return 1;
+	}
+	int rounds = atoi(argv[1]);
+	vector<Sample> samples;
+	for (int arg = 2; arg < argc; arg++) {
+		string filename = argv[arg];
+		string name = filename.substr(filename.rfind('/') + 1);
+		Sample sample;
+		sample.convert = (name.find("c3") == 0) ? c3_main :
+			(name.find("pharaoh") == 0) ? pharaoh_main : zeus_main;
+		sample.filename = filename;
+		sample.valid = true;
+		samples.push_back(sample);
+		
+		// The same file cut in half
+		vector<unsigned char> data = readTestFile(filename);
+		sample.filename = "tests/leakcheck-" + name + ".tmp";
+		sample.valid = false;
+		ofstream out(sample.filename.c_str(), ios::out | ios::binary);
+		out.write((const char *)&data[0], data.size() / 2);
+		out.close();
+		samples.push_back(sample);
+	}
+	
+	// The mappers complain about the broken files on stderr
+	int saved_stderr = dup(2);
+	int null = open("/dev/null", O_WRONLY);
+	dup2(null, 2);
+	
+	// The first rounds fill the arena, the libraries' caches and the heap
+	for (int i = 0; i < 3; i++) {
+		convertAll(samples);
+	}
+	long before = residentKB();
+	for (int i = 0; i < rounds; i++) {
+		convertAll(samples);
+	}
+	long after = residentKB();
+	
+	dup2(saved_stderr, 2);
+	close(null);
+	
+	test_file = "all samples";
+	printf("leakcheck: %d conversions, %ld KB before, %ld KB after\n",
+		rounds * (int)samples.size(), before, after);
+#ifndef __SANITIZE_ADDRESS__
+	CHECK(after - before <= MAX_GROWTH);
+#else
+	// AddressSanitizer holds on to freed memory for a while, so the
+	// process grows anyway; it reports leaks itself on exit
+#endif
+	
+	for (unsigned int i = 0; i < samples.size(); i++) {
+		if (!samples[i].valid) {
+			remove(samples[i].filename.c_str());
+		}
+	}
+	remove(OUTPUT_FILE);
+	return testResult("leakcheck", samples.size());
+}
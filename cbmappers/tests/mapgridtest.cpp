@@ -0,0 +1,126 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "mapgrid.h"
+#include "mapmodel.h"
+#include "testutil.h"
+
+using namespace std;
+
+/**
+* Checks MapGrid against the full grid it is loaded from: tiles of the
+* map and of the margin around it must read the same as in the full
+* grid, everything further out 0, and the tiles of the map must be
+* numbered row by row without gaps. The shape of the map comes from the
+* same formula the render loops use.
+* Usage: mapgridtest
+*/
+
+/**
+* Whether (x, y) is part of the map, as the render loops decide it
+*/
+static bool onMap(int x, int y, int size, int mapsize, MapShape shape) {
+	int half = size / 2;
+	int border = (size - mapsize) / 2;
+	int max = border + mapsize;
+	if (y < border || y >= max) {
+		return false;
+	}
+	if (shape == MAP_SQUARE) {
+		return x >= border && x < max;
+	}
+	int start = (y < half) ? (border + half - y - 1) : (border + y - half);
+	int end   = (y < half) ? (half + y + 1 - border) : (3*half - y - border);
+	return x >= start && x < end;
+}
+
+/**
+* Value of (x, y) in the full grid
+*/
+static unsigned int value(int x, int y) {
+	return x * 1000 + y + 1;
+}
+
+static void check(int size, int mapsize, MapShape shape, Arena *arena) {
+	vector<unsigned char> file(size * size * 4);
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			unsigned int v = value(x, y);
+			for (int i = 0; i < 4; i++) {
+				file[(y * size + x) * 4 + i] = (unsigned char)(v >> (i*8));
+			}
+		}
+	}
+	GridView<unsigned int> view(&file[0], size, size);
+	MapGrid<unsigned int> grid(size, mapsize, shape, arena);
+	MapModel::load(&grid, view);
+	
+	int tile = 0;
+	for (int y = -2; y < size + 2; y++) {
+		for (int x = -2; x < size + 2; x++) {
+			bool map = onMap(x, y, size, mapsize, shape);
+			bool margin = false;
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					margin |= onMap(x + dx, y + dy, size, mapsize, shape);
+				}
+			}
+			margin &= (x >= 0 && y >= 0 && x < size && y < size);
+			
+			CHECK(grid.contains(x, y) == map);
+			CHECK(grid.get(x, y) == (margin ? value(x, y) : 0));
+			if (map) {
+				CHECK(grid.index(x, y) == tile);
+				CHECK(grid.row(y)[x - grid.begin(y)] == value(x, y));
+				tile++;
+			}
+		}
+	}
+	CHECK(grid.tiles() == tile);
+	
+	grid.fill(7);
+	grid.set(0, 0, 9);
+	for (int y = 0; y < size; y++) {
+		for (int x = grid.marginBegin(y); x < grid.marginEnd(y); x++) {
+			CHECK(grid.get(x, y) == ((x == 0 && y == 0) ? 9u : 7u));
+		}
+	}
+}
+
+int main() {
+	Arena arena;
+	int cases = 0;
+	int sizes[] = {162, 228, 11, 10, 3};
+	for (int s = 0; s < 5; s++) {
+		int size = sizes[s];
+		int mapsizes[] = {size, size - 1, size - 2, size / 2, 40, 1, 0};
+		for (int m = 0; m < 7; m++) {
+			if (mapsizes[m] < 0 || mapsizes[m] > size) {
+				continue;
+			}
+			for (int shape = 0; shape < 2; shape++) {
+				test_file = (shape == MAP_SQUARE) ? "square" : "diamond";
+				check(size, mapsizes[m], (MapShape)shape, NULL);
+				check(size, mapsizes[m], (MapShape)shape, &arena);
+				arena.reset();
+				cases += 2;
+			}
+		}
+	}
+	return testResult("mapgridtest", cases);
+}
@@ -0,0 +1,257 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <sstream>
+#include <vector>
+#include "pkwareinputstream.h"
+#include "pkindex.h"
+#include "mappedfile.h"
+
+using namespace std;
+
+/**
+* Benchmark of the PKWare decoder on the synthetic chunks in
+* tests/data/bench, the sizes and record layouts of the tables in the
+* saved games:
+*   walkers.pk    2000 walkers of 388 bytes (776 KB)
+*   buildings.pk  4000 buildings of 280 bytes (1.1 MB)
+*   terrain*.pk   228x228 grids of ints (208 KB)
+*   pattern.pk    the same, a 4-byte pattern
+*   zero.pk       the same, all zeroes
+* Times are averages per chunk, in microseconds.
+* Usage: pkbench directory
+*/
+
+static const int RUNS = 200;
+
+typedef chrono::steady_clock Clock;
+
+/**
+* A compressed chunk and its decompressed size
+*/
+typedef struct {
+	string name;
+	vector<unsigned char> data;
+	int size;
+} Chunk;
+
+static Chunk load(string directory, string name) {
+	Chunk chunk;
+	MappedFile file(directory + "/" + name + ".pk");
+	chunk.name = name;
+	chunk.data.assign(file.data(), file.data() + file.size());
+	PKWareInputStream pk;
+	pk.reset(&chunk.data[0], chunk.data.size());
+	chunk.size = 0;
+	int count;
+	while (pk.decode(NULL, 65536, &count) == PK_OK) {
+		chunk.size += count;
+	}
+	chunk.size += count;
+	return chunk;
+}
+
+static double since(Clock::time_point start, int runs) {
+	return chrono::duration<double, micro>(Clock::now() - start).count() / runs;
+}
+
+/**
+* Reads what the walker parsers use of each walker record: type and
+* position
+*/
+static unsigned long readWalkers(PKWareInputStream *pk) {
+	unsigned long sum = 0;
+	for (int i = 0; i < 2000; i++) {
+		pk->skip(10);
+		sum += pk->readShort();
+		pk->skip(8);
+		sum += pk->readShort();
+		sum += pk->readShort();
+		pk->skip(364);
+	}
+	return sum;
+}
+
+/**
+* Reads what the building parsers use of each building record
+*/
+static unsigned long readBuildings(PKWareInputStream *pk) {
+	unsigned long sum = 0;
+	for (int i = 0; i < 4000; i++) {
+		pk->skip(3);
+		sum += pk->readByte();
+		pk->skip(2);
+		sum += pk->readShort();
+		sum += pk->readShort();
+		pk->skip(6);
+		sum += pk->readShort();
+		pk->skip(154);
+		sum += pk->readByte();
+		pk->skip(107);
+	}
+	return sum;
+}
+
+/**
+* Reads a chunk from a stream, record by record (`mode' 0 for walkers,
+* 1 for buildings), int by int (2) or byte by byte (3)
+* @param known Whether to pass the decompressed size, which decodes
+* the whole chunk up front
+*/
+static double streaming(const Chunk &chunk, int mode, bool known, unsigned long *sum) {
+	string data(chunk.data.begin(), chunk.data.end());
+	Clock::time_point start = Clock::now();
+	for (int run = 0; run < RUNS; run++) {
+		istringstream in(data);
+		PKWareInputStream pk(&in, false, data.size(), known ? chunk.size : -1);
+		switch (mode) {
+			case 0: *sum += readWalkers(&pk); break;
+			case 1: *sum += readBuildings(&pk); break;
+			case 2:
+				for (int i = 0; i < chunk.size / 4; i++) {
+					*sum += pk.readInt();
+				}
+				break;
+			case 3:
+				for (int i = 0; i < chunk.size; i++) {
+					*sum += pk.readByte();
+				}
+				break;
+		}
+		pk.empty();
+	}
+	return since(start, RUNS);
+}
+
+/**
+* Decompresses `count' chunks one after the other, then interleaved
+*/
+static void interleave(int count, const Chunk **chunks) {
+	PKWareInputStream decoders[PKWareInputStream::MAX_INTERLEAVE];
+	PKWareInputStream *pointers[PKWareInputStream::MAX_INTERLEAVE];
+	vector<unsigned char> out[PKWareInputStream::MAX_INTERLEAVE];
+	unsigned char *dst[PKWareInputStream::MAX_INTERLEAVE];
+	int capacity[PKWareInputStream::MAX_INTERLEAVE];
+	PKStatus status[PKWareInputStream::MAX_INTERLEAVE];
+	string names;
+	for (int i = 0; i < count; i++) {
+		out[i].resize(chunks[i]->size);
+		dst[i] = &out[i][0];
+		capacity[i] = chunks[i]->size;
+		pointers[i] = &decoders[i];
+		names += (i ? " " : "") + chunks[i]->name;
+	}
+	
+	Clock::time_point start = Clock::now();
+	for (int run = 0; run < RUNS; run++) {
+		for (int i = 0; i < count; i++) {
+			decoders[i].reset(&chunks[i]->data[0], chunks[i]->data.size());
+			decoders[i].decompress(dst[i], capacity[i]);
+		}
+	}
+	double serial = since(start, RUNS);
+	
+	start = Clock::now();
+	for (int run = 0; run < RUNS; run++) {
+		for (int i = 0; i < count; i++) {
+			decoders[i].reset(&chunks[i]->data[0], chunks[i]->data.size());
+		}
+		PKWareInputStream::decompress(count, pointers, dst, capacity, status);
+	}
+	double interleaved = since(start, RUNS);
+	printf("  %-36s %8.0f %8.0f\n", names.c_str(), serial, interleaved);
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: pkbench directory\n");
+		return 1;
+	}
+	string directory = argv[1];
+	Chunk zero = load(directory, "zero");
+	Chunk pattern = load(directory, "pattern");
+	Chunk terrain = load(directory, "terrain");
+	Chunk walkers = load(directory, "walkers");
+	Chunk buildings = load(directory, "buildings");
+	Chunk terrain2 = load(directory, "terrain2");
+	Chunk terrain3 = load(directory, "terrain3");
+	Chunk terrain4 = load(directory, "terrain4");
+	unsigned long sum = 0;
+	
+	printf("decompressChunk(), us per chunk\n");
+	const Chunk *whole[] = {&zero, &pattern, &terrain, &walkers, &buildings};
+	for (int c = 0; c < 5; c++) {
+		vector<unsigned char> out(whole[c]->size);
+		Clock::time_point start = Clock::now();
+		for (int run = 0; run < RUNS; run++) {
+			PKWareInputStream::decompressChunk(&whole[c]->data[0],
+				whole[c]->data.size(), &out[0], out.size());
+		}
+		printf("  %-10s %8d bytes %8.0f\n", whole[c]->name.c_str(), whole[c]->size,
+			since(start, RUNS));
+	}
+	
+	printf("Reading from a stream, us per chunk: length unknown, known\n");
+	const char *modes[] = {"walker records", "building records", "readInt() over terrain", "readByte() over walkers"};
+	const Chunk *streamed[] = {&walkers, &buildings, &terrain, &walkers};
+	for (int mode = 0; mode < 4; mode++) {
+		double unknown = streaming(*streamed[mode], mode, false, &sum);
+		double known = streaming(*streamed[mode], mode, true, &sum);
+		printf("  %-24s %8.0f %8.0f\n", modes[mode], unknown, known);
+	}
+	
+	printf("PKIndex, us: reading one record, decoding everything, index bytes\n");
+	const Chunk *indexed[] = {&buildings, &walkers};
+	int intervals[] = {32768, 16384};
+	int records[] = {280, 388};
+	for (int c = 0; c < 2; c++) {
+		const Chunk &chunk = *indexed[c];
+		PKIndex index;
+		index.build(&chunk.data[0], chunk.data.size(), chunk.size, intervals[c]);
+		index.save("tests/pkbench.tmp");
+		int index_size = MappedFile("tests/pkbench.tmp").size();
+		remove("tests/pkbench.tmp");
+		unsigned char record[2];
+		Clock::time_point start = Clock::now();
+		for (int run = 0; run < RUNS; run++) {
+			index.read(&chunk.data[0], chunk.data.size(), 1234 * records[c] + 16, record, 2);
+		}
+		double query = since(start, RUNS);
+		vector<unsigned char> out(chunk.size);
+		start = Clock::now();
+		for (int run = 0; run < RUNS; run++) {
+			PKWareInputStream::decompressChunk(&chunk.data[0], chunk.data.size(), &out[0], out.size());
+		}
+		printf("  %-10s %5d KB interval %8.1f %8.0f %8d\n", chunk.name.c_str(),
+			intervals[c] / 1024, query, since(start, RUNS), index_size);
+	}
+	
+	printf("Several chunks, us: one after the other, interleaved\n");
+	const Chunk *two[] = {&terrain2, &terrain3};
+	const Chunk *four[] = {&terrain, &terrain2, &terrain3, &terrain4};
+	const Chunk *mixed[] = {&walkers, &buildings, &terrain2, &zero};
+	interleave(2, two);
+	interleave(4, four);
+	interleave(4, mixed);
+	
+	printf("(checksum %lu)\n", sum);
+	return 0;
+}
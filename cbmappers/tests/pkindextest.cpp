@@ -0,0 +1,139 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include "pkindex.h"
+#include "testutil.h"
+
+using namespace std;
+
+/**
+* Checks PKIndex: builds an index for each test vector, saves it and
+* loads it back, and compares reads starting at and between its
+* checkpoints with the decompressed file. Then checks that load()
+* rejects an index for other data and damaged index files.
+* Usage: pkindextest file.pk...
+*/
+
+static const char INDEX_FILE[] = "tests/pkindextest.tmp";
+static const int INTERVAL = 1000;
+
+/**
+* Reads the index file
+*/
+static string readIndex() {
+	vector<unsigned char> data = readTestFile(INDEX_FILE);
+	return string(data.begin(), data.end());
+}
+
+/**
+* Writes `data' as the index file
+*/
+static void writeIndex(string data) {
+	ofstream out(INDEX_FILE, ios::out | ios::binary);
+	out.write(data.data(), data.size());
+}
+
+/**
+* Overwrites the little-endian int at `offset' in an index file image
+*/
+static string patchInt(string data, int offset, int number) {
+	for (int i = 0; i < 4; i++) {
+		data[offset + i] = (char)((unsigned int)number >> (i*8));
+	}
+	return data;
+}
+
+int main(int argc, char **argv) {
+	int files = 0;
+	for (int arg = 1; arg < argc; arg++) {
+		test_file = argv[arg];
+		vector<unsigned char> pk = readTestFile(argv[arg]);
+		vector<unsigned char> raw = readTestFile(rawName(argv[arg]));
+		int size = raw.size();
+		if (size == 0) {
+			// Nothing to index, but building must still work
+			PKIndex empty;
+			CHECK(empty.build(pk.data(), pk.size(), 0, INTERVAL) == PK_OK);
+			CHECK(empty.read(pk.data(), pk.size(), 0, NULL, 0) == PK_CORRUPT);
+			continue;
+		}
+		files++;
+		
+		PKIndex built;
+		CHECK(built.build(&pk[0], pk.size(), size, INTERVAL) == PK_OK);
+		CHECK(built.save(INDEX_FILE));
+		PKIndex index;
+		CHECK(index.load(INDEX_FILE, &pk[0], pk.size()));
+		
+		// Reads from each checkpoint to the end, from just before and
+		// after it, and at random
+		vector<unsigned char> buf(size);
+		for (int checkpoint = 0; checkpoint < size; checkpoint += INTERVAL) {
+			int offsets[] = {checkpoint, checkpoint - 1, checkpoint + 1, rand() % size};
+			for (int i = 0; i < 4; i++) {
+				int offset = offsets[i];
+				if (offset < 0 || offset >= size) {
+					continue;
+				}
+				int count = size - offset;
+				int written = -1;
+				CHECK(index.read(&pk[0], pk.size(), offset, &buf[0], count, &written) == PK_OK);
+				CHECK(written == count);
+				CHECK(memcmp(&buf[0], &raw[offset], count) == 0);
+			}
+		}
+		
+		// An index for data that has changed since is stale
+		vector<unsigned char> changed(pk);
+		changed[changed.size() / 2] ^= 0x10;
+		CHECK(!index.load(INDEX_FILE, &changed[0], changed.size()));
+		CHECK(!index.load(INDEX_FILE, &pk[0], pk.size() - 1));
+		CHECK(index.read(&pk[0], pk.size(), 0, &buf[0], 1) == PK_CORRUPT);
+		
+		// Damaged index files. The checkpoint count is at 12, the first
+		// checkpoint at 16 and the second one, if any, at 28
+		string good = readIndex();
+		int checkpoints = (size + INTERVAL - 1) / INTERVAL;
+		vector<string> damaged;
+		damaged.push_back("");
+		damaged.push_back(good.substr(0, good.size() - 1));
+		damaged.push_back("PKIY" + good.substr(4));
+		damaged.push_back(patchInt(good, 12, checkpoints + 1));
+		damaged.push_back(patchInt(good, 16, 1)); // output offset
+		damaged.push_back(patchInt(good, 20, pk.size() * 8 + 1)); // bit offset
+		damaged.push_back(patchInt(good, 24, 5000)); // window length
+		if (checkpoints > 1) {
+			damaged.push_back(patchInt(good, 28, 0));
+			damaged.push_back(patchInt(good, 32, -8));
+			damaged.push_back(patchInt(good, 36, 4097));
+		}
+		for (unsigned int i = 0; i < damaged.size(); i++) {
+			writeIndex(damaged[i]);
+			CHECK(!index.load(INDEX_FILE, &pk[0], pk.size()));
+		}
+		CHECK(!index.load("tests/no such file", &pk[0], pk.size()));
+		writeIndex(good);
+		CHECK(index.load(INDEX_FILE, &pk[0], pk.size()));
+	}
+	remove(INDEX_FILE);
+	return testResult("pkindextest", files);
+}
@@ -0,0 +1,113 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <string.h>
+#include "pkwareinputstream.h"
+#include "testutil.h"
+
+using namespace std;
+
+/**
+* Checks the interleaved PKWareInputStream::decompress() of several
+* blocks at once against calling decompress() on each block in turn:
+* the status, the number of bytes written and the bytes themselves must
+* be the same, for buffers larger and smaller than the decompressed
+* data, for cut-off blocks, and without writing past the buffers.
+* Usage: pkinterleavetest file.pk...
+*/
+
+static const int GUARD = 64; // bytes after each buffer that must stay untouched
+static const unsigned char FILL = 0xA5;
+
+/**
+* Block to decompress and the capacity to give it
+*/
+typedef struct {
+	const vector<unsigned char> *data;
+	int length;
+	int capacity;
+} Block;
+
+/**
+* Decompresses `count' blocks both ways and compares the results
+*/
+static void compare(int count, const Block *blocks) {
+	PKWareInputStream decoders[PKWareInputStream::MAX_INTERLEAVE];
+	PKWareInputStream *pointers[PKWareInputStream::MAX_INTERLEAVE];
+	vector<unsigned char> buffers[PKWareInputStream::MAX_INTERLEAVE];
+	unsigned char *dst[PKWareInputStream::MAX_INTERLEAVE];
+	int capacity[PKWareInputStream::MAX_INTERLEAVE];
+	PKStatus status[PKWareInputStream::MAX_INTERLEAVE];
+	int written[PKWareInputStream::MAX_INTERLEAVE];
+	for (int i = 0; i < count; i++) {
+		decoders[i].reset(&(*blocks[i].data)[0], blocks[i].length);
+		pointers[i] = &decoders[i];
+		buffers[i].assign(blocks[i].capacity + GUARD, FILL);
+		dst[i] = &buffers[i][0];
+		capacity[i] = blocks[i].capacity;
+	}
+	PKWareInputStream::decompress(count, pointers, dst, capacity, status, written);
+	
+	for (int i = 0; i < count; i++) {
+		PKWareInputStream pk;
+		pk.reset(&(*blocks[i].data)[0], blocks[i].length);
+		vector<unsigned char> expected(blocks[i].capacity + GUARD, FILL);
+		int expected_written = -1;
+		CHECK(pk.decompress(&expected[0], blocks[i].capacity, &expected_written) == status[i]);
+		CHECK(expected_written == written[i]);
+		CHECK(written[i] >= 0 && written[i] <= blocks[i].capacity);
+		CHECK(buffers[i] == expected);
+	}
+}
+
+int main(int argc, char **argv) {
+	vector<vector<unsigned char> > pk(argc - 1);
+	vector<int> sizes(argc - 1);
+	for (int arg = 1; arg < argc; arg++) {
+		pk[arg - 1] = readTestFile(argv[arg]);
+		sizes[arg - 1] = readTestFile(rawName(argv[arg])).size();
+	}
+	
+	// Each file with the ones after it, in groups of one to four
+	for (int first = 0; first < argc - 1; first++) {
+		test_file = argv[first + 1];
+		for (int count = 1; count <= PKWareInputStream::MAX_INTERLEAVE; count++) {
+			for (int variant = 0; variant < 5; variant++) {
+				Block blocks[PKWareInputStream::MAX_INTERLEAVE];
+				for (int i = 0; i < count; i++) {
+					int file = (first + i) % (argc - 1);
+					int size = sizes[file];
+					blocks[i].data = &pk[file];
+					blocks[i].length = pk[file].size();
+					switch ((variant + i) % 5) {
+						case 0: blocks[i].capacity = size; break;
+						case 1: blocks[i].capacity = size + 1000; break;
+						case 2: blocks[i].capacity = size / 2; break;
+						case 3: blocks[i].capacity = (size > 0) ? size - 1 : 0; break;
+						case 4: // cut off
+							blocks[i].capacity = size;
+							blocks[i].length = pk[file].size() / 2 + 1;
+							break;
+					}
+				}
+				compare(count, blocks);
+			}
+		}
+	}
+	return testResult("pkinterleavetest", argc - 1);
+}
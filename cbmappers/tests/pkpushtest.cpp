@@ -0,0 +1,159 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pkwareinputstream.h"
+#include "testutil.h"
+
+using namespace std;
+
+/**
+* Checks the push mode of PKWareInputStream, feed() and finish(), against
+* the pull decoder reading the same block from memory: the compressed
+* data is fed in 1-byte slices, in slices of random sizes, and cut short,
+* and the output and final status must come out the same every time.
+* Usage: pkpushtest file.pk...
+*/
+
+/**
+* Decodes `length' bytes of `data' the usual way, into `out'
+*/
+static PKStatus pull(const unsigned char *data, int length, string *out) {
+	PKWareInputStream pk;
+	PKStatus result = pk.reset(data, length);
+	unsigned char buf[1000];
+	int count;
+	while (result == PK_OK) {
+		result = pk.decode(buf, sizeof(buf), &count);
+		out->append((char *)buf, count);
+	}
+	return result;
+}
+
+/**
+* Feeds `length' bytes of `data' into a decoder in slices of at most
+* `max_slice' bytes, decoding pieces of random sizes in between, and
+* appends the output to `out'. Each slice is copied into a scratch
+* buffer that is overwritten as soon as the decoder is done with it.
+* @param max_slice 1 for single bytes, otherwise random slice sizes
+*/
+static PKStatus push(const unsigned char *data, int length, int max_slice,
+		string *out) {
+	PKWareInputStream pk;
+	pk.reset();
+	unsigned char slice[256];
+	unsigned char buf[1000];
+	int count;
+	PKStatus result = PK_NEED_INPUT;
+	int offset = 0;
+	while (offset < length && result == PK_NEED_INPUT) {
+		int size = (max_slice == 1) ? 1 : rand() % max_slice + 1;
+		if (size > length - offset) {
+			size = length - offset;
+		}
+		memcpy(slice, data + offset, size);
+		offset += size;
+		pk.feed(slice, size);
+		do {
+			result = pk.decode(buf, rand() % sizeof(buf) + 1, &count);
+			out->append((char *)buf, count);
+		} while (result == PK_OK);
+		memset(slice, 0xAA, sizeof(slice));
+	}
+	pk.finish();
+	while (result == PK_OK || result == PK_NEED_INPUT) {
+		result = pk.decode(buf, sizeof(buf), &count);
+		out->append((char *)buf, count);
+	}
+	return result;
+}
+
+/**
+* Checks that pushing `length' bytes of `data' in various ways gives
+* the same as pulling them
+*/
+static void compare(const unsigned char *data, int length) {
+	string expected;
+	PKStatus expected_result = pull(data, length, &expected);
+	
+	string output;
+	CHECK(push(data, length, 1, &output) == expected_result);
+	CHECK(output == expected);
+	for (int i = 0; i < 20; i++) {
+		output.clear();
+		CHECK(push(data, length, (i < 10) ? 16 : 256, &output) == expected_result);
+		CHECK(output == expected);
+	}
+}
+
+int main(int argc, char **argv) {
+	srand(1);
+	for (int arg = 1; arg < argc; arg++) {
+		test_file = argv[arg];
+		vector<unsigned char> pk = readTestFile(argv[arg]);
+		vector<unsigned char> raw = readTestFile(rawName(argv[arg]));
+		string expected(raw.begin(), raw.end());
+		
+		// The pull decoder itself
+		string output;
+		CHECK(pull(&pk[0], pk.size(), &output) == PK_END_OF_STREAM);
+		CHECK(output == expected);
+		
+		compare(&pk[0], pk.size());
+		
+		// Cut short: finish() must turn PK_NEED_INPUT into PK_TRUNCATED
+		compare(&pk[0], pk.size() - 1);
+		compare(&pk[0], pk.size() / 2);
+		compare(&pk[0], 3);
+		
+		// The header split over two feed() calls
+		PKWareInputStream split;
+		split.reset();
+		int count = -1;
+		split.feed(&pk[0], 1);
+		CHECK(split.decode(NULL, 1, &count) == PK_NEED_INPUT);
+		CHECK(count == 0);
+		split.feed(&pk[1], pk.size() - 1);
+		output.clear();
+		PKStatus result;
+		unsigned char buf[1000];
+		do {
+			result = split.decode(buf, sizeof(buf), &count);
+			output.append((char *)buf, count);
+			if (result == PK_NEED_INPUT) {
+				split.finish();
+				result = PK_OK;
+			}
+		} while (result == PK_OK);
+		CHECK(result == PK_END_OF_STREAM);
+		CHECK(output == expected);
+		
+		// finish() before the header is complete
+		for (int length = 0; length < 2; length++) {
+			PKWareInputStream pk_short;
+			pk_short.reset();
+			pk_short.feed(&pk[0], length);
+			pk_short.finish();
+			count = -1;
+			CHECK(pk_short.decode(buf, 1, &count) == PK_TRUNCATED);
+			CHECK(count == 0);
+		}
+	}
+	return testResult("pkpushtest", argc - 1);
+}
@@ -0,0 +1,157 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "c3file.h"
+#include "pharaohfile.h"
+#include "zeusfile.h"
+#include "pngimage.h"
+
+using namespace std;
+
+/**
+* Benchmark of drawing and writing the minimaps:
+* - a 456x228 image, the size of the largest Pharaoh and Zeus maps,
+*   filled through setRGB() in runs of a few colours, the way the
+*   renderers draw tiles, then written; average of 200 runs
+* - getImage() on each sample file, fastest of 100 runs
+* - writing the minimaps of all sample files with each compression
+*   preset, fastest of 20 runs
+* Usage: pngbench file...
+*/
+
+static const char OUTPUT_FILE[] = "tests/pngbench.tmp.png";
+
+typedef chrono::steady_clock Clock;
+
+static double since(Clock::time_point start) {
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static long fileSize(const char *filename) {
+	struct stat info;
+	return (stat(filename, &info) == 0) ? (long)info.st_size : -1;
+}
+
+/**
+* Fills and writes the 456x228 image with `k' colours
+*/
+static void writeImage(int k) {
+	static const int table[] = {0x4a7c2c, 0x3b6b22, 0x7c9b3a, 0x2b4f8c,
+		0x1f3f7a, 0xb09060, 0x8c7050, 0x606060, 0xc8b48c, 0xa02020, 0x20a020,
+		0xe0e0a0, 0x806040, 0x404080, 0xd0a050, 0x305020, 0x90c0e0, 0xf0d080,
+		0x702030, 0x507090, 0xa0a0a0, 0x60a040, 0xc06040, 0x2060c0};
+	const int width = 456, height = 228, runs = 200;
+	vector<int> colours(width * height);
+	srand(1);
+	for (int y = 0; y < height; y++) {
+		int c = table[rand() % k];
+		for (int x = 0; x < width; x += 2) {
+			if (rand() % 6 == 0) {
+				c = table[rand() % k];
+			}
+			colours[y * width + x] = colours[y * width + x + 1] = c;
+		}
+	}
+	
+	double fill = 0, write = 0;
+	for (int run = 0; run < runs; run++) {
+		Clock::time_point start = Clock::now();
+		PNGImage img(width, height);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				img.setRGB(x, y, colours[y * width + x]);
+			}
+		}
+		fill += since(start);
+		start = Clock::now();
+		img.write(OUTPUT_FILE);
+		write += since(start);
+	}
+	printf("  %2d colours %8.2f %8.2f %8ld\n", k, fill / runs, write / runs,
+		fileSize(OUTPUT_FILE));
+}
+
+/**
+* Draws the minimap of `filename' with the mapper of its game
+*/
+static unique_ptr<IndexedPNGImage> draw(string filename) {
+	string name = filename.substr(filename.rfind('/') + 1);
+	if (name.find("c3") == 0) {
+		C3File file(filename);
+		return file.getImage();
+	} else if (name.find("pharaoh") == 0) {
+		PharaohFile file(filename);
+		return file.getImage();
+	}
+	ZeusFile file(filename);
+	file.getNumMaps();
+	return file.getImage();
+}
+
+int main(int argc, char **argv) {
+	printf("456x228 image, ms: setRGB() fill, write(), file bytes\n");
+	int ks[] = {2, 4, 16, 24};
+	for (int i = 0; i < 4; i++) {
+		writeImage(ks[i]);
+	}
+	
+	printf("getImage(), ms\n");
+	vector<unique_ptr<IndexedPNGImage> > images;
+	for (int arg = 1; arg < argc; arg++) {
+		double best = 1e9;
+		for (int run = 0; run < 100; run++) {
+			Clock::time_point start = Clock::now();
+			unique_ptr<IndexedPNGImage> img = draw(argv[arg]);
+			double time = since(start);
+			best = (time < best) ? time : best;
+			if (run == 0) {
+				images.push_back(move(img));
+			}
+		}
+		printf("  %-28s %8.2f\n", argv[arg], best);
+	}
+	
+	printf("Writing all %d minimaps, ms and total bytes\n", argc - 1);
+	const char *names[] = {"fast", "balanced", "smallest"};
+	for (int p = 0; p < 3; p++) {
+		PNGCompression compression;
+		PNGWriter::preset(names[p], &compression);
+		double best = 1e9;
+		long bytes = 0;
+		for (int run = 0; run < 20; run++) {
+			bytes = 0;
+			Clock::time_point start = Clock::now();
+			for (unsigned int i = 0; i < images.size(); i++) {
+				images[i]->setCompression(compression);
+				images[i]->write(OUTPUT_FILE);
+				bytes += fileSize(OUTPUT_FILE);
+			}
+			double time = since(start);
+			best = (time < best) ? time : best;
+		}
+		printf("  %-10s %8.2f %8ld\n", names[p], best, bytes);
+	}
+	remove(OUTPUT_FILE);
+	return 0;
+}
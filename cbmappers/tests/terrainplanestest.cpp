@@ -0,0 +1,111 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include "terrainplanes.h"
+#include "mapmodel.h"
+#include "testutil.h"
+
+using namespace std;
+
+/**
+* Checks the counts of TerrainPlanes against counting the tiles of the
+* terrain layer of a MapModel one by one, for random terrain on square
+* and diamond maps. The full grid has flags outside the map as well,
+* which must not be counted.
+* Usage: terrainplanestest
+*/
+
+static int naiveCount(const MapGrid<unsigned int> &terrain, unsigned int mask,
+		bool all, int x1, int y1, int x2, int y2) {
+	int total = 0;
+	for (int y = y1; y < y2; y++) {
+		for (int x = x1; x < x2; x++) {
+			if (!terrain.contains(x, y)) {
+				continue;
+			}
+			unsigned int flags = terrain.get(x, y);
+			if (all ? (flags & mask) == mask : (flags & mask) != 0) {
+				total++;
+			}
+		}
+	}
+	return total;
+}
+
+static void check(int size, int mapsize, MapShape shape) {
+	// Few flags, some common and some rare, as in the game files
+	vector<unsigned char> file(size * size * 4);
+	for (int i = 0; i < size * size; i++) {
+		unsigned int flags = 0;
+		for (int bit = 0; bit < 12; bit++) {
+			if (rand() % (bit + 2) == 0) {
+				flags |= 1u << bit;
+			}
+		}
+		if (rand() % 500 == 0) {
+			flags |= 0x40000000;
+		}
+		for (int b = 0; b < 4; b++) {
+			file[i * 4 + b] = (unsigned char)(flags >> (b*8));
+		}
+	}
+	MapModel model(size, mapsize, shape);
+	MapModel::load(&model.terrain, GridView<unsigned int>(&file[0], size, size));
+	const MapGrid<unsigned int> &terrain = model.terrain;
+	TerrainPlanes planes(terrain);
+	
+	unsigned int masks[] = {0, 0x1, 0x8, 0x48, 0x3, 0x7ff, 0x800, 0x1000,
+		0x40000000, 0x40000001, 0xffffffff};
+	for (int m = 0; m < 11; m++) {
+		unsigned int mask = masks[m];
+		int count = naiveCount(terrain, mask, false, 0, 0, size, size);
+		CHECK(planes.count(mask) == count);
+		CHECK(planes.any(mask) == (count > 0));
+		int expected_all = mask ? naiveCount(terrain, mask, true, 0, 0, size, size) : terrain.tiles();
+		CHECK(planes.countAll(mask) == expected_all);
+		
+		// Rectangles inside the map, across its edges and past them
+		for (int r = 0; r < 20; r++) {
+			int x1 = rand() % (size + 20) - 10;
+			int y1 = rand() % (size + 20) - 10;
+			int x2 = x1 + rand() % (size / 2 + 2);
+			int y2 = y1 + rand() % (size / 2 + 2);
+			CHECK(planes.count(mask, x1, y1, x2, y2) ==
+				naiveCount(terrain, mask, false, x1, y1, x2, y2));
+		}
+	}
+}
+
+int main() {
+	srand(1);
+	int cases = 0;
+	int sizes[] = {162, 228, 11};
+	for (int s = 0; s < 3; s++) {
+		int size = sizes[s];
+		int mapsizes[] = {size, size - 1, size / 2, 1};
+		for (int m = 0; m < 4; m++) {
+			for (int shape = 0; shape < 2; shape++) {
+				test_file = (shape == MAP_SQUARE) ? "square" : "diamond";
+				check(size, mapsizes[m], (MapShape)shape);
+				cases++;
+			}
+		}
+	}
+	return testResult("terrainplanestest", cases);
+}
@@ -0,0 +1,75 @@
+/*
+ *   CBMappers - create minimaps from Citybuilder scenarios and saved games
+ *   Copyright (C) 2007  Bianca van Schaik
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef testutil_h
+#define testutil_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+
+/**
+* Helpers shared by the test programs run by `make check'. Each program
+* takes its test files on the command line, reports every failed check
+* and exits with a non-zero status if there were any.
+*/
+
+static const char *test_file = ""; // file being tested, for the reports
+static int test_failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: %s: check failed: %s\n", \
+				__FILE__, __LINE__, test_file, #condition); \
+			test_failures++; \
+		} \
+	} while (0)
+
+/**
+* Reads a whole file
+* @throws const char* if the file can't be read
+*/
+static inline std::vector<unsigned char> readTestFile(std::string filename) {
+	MappedFile file(filename);
+	return std::vector<unsigned char>(file.data(), file.data() + file.size());
+}
+
+/**
+* Returns the name of the file holding the decompressed contents of
+* compressed test file `filename': the same name ending in .raw
+*/
+static inline std::string rawName(std::string filename) {
+	return filename.substr(0, filename.rfind('.')) + ".raw";
+}
+
+/**
+* Prints the outcome and returns the exit status for main()
+* @param cases Number of files or situations tested
+*/
+static inline int testResult(const char *program, int cases) {
+	if (test_failures > 0) {
+		fprintf(stderr, "%s: %d checks failed\n", program, test_failures);
+		return 1;
+	}
+	printf("%s: %d cases ok\n", program, cases);
+	return 0;
+}
+
+#endif /* testutil_h */
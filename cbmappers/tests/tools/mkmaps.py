@@ -0,0 +1,143 @@
+# Writes the sample files in tests/data/maps: synthetic Caesar 3, Pharaoh
+# and Zeus scenarios and saved games, laid out the way the mappers read
+# them, with random terrain, buildings and walkers. The seeds are fixed,
+# so running it again gives the same files.
+#   python3 tests/tools/mkmaps.py tests/data/maps
+import os, random, struct, sys
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from pkimplode import implode
+
+class W:
+    def __init__(s): s.b = bytearray()
+    def raw(s, d): s.b += d
+    def pad(s, n): s.b += bytes(n)
+    def u32(s, v): s.b += struct.pack('<I', v)
+    def at(s, pos):
+        assert len(s.b) <= pos, (len(s.b), pos); s.b += bytes(pos - len(s.b))
+    def chunk(s, data, bits=6):
+        c = implode(data, bits); s.u32(len(c)); s.b += c
+    def junk(s, r, n):
+        s.chunk(bytes(r.choice([0, 0, 0, 1, 0xff]) for _ in range(n)), r.choice([4, 5, 6]))
+
+def runs(r, n, choices, maxrun=40):
+    out = []
+    while len(out) < n:
+        out += [r.choice(choices)] * r.randint(1, maxrun)
+    return out[:n]
+
+def grid_bytes(vals, fmt):
+    return b''.join(struct.pack('<' + fmt, v) for v in vals)
+
+def edges(r, n):
+    return bytes(runs(r, n, [0, 64, 1, 8, 9, 0x41, 2, 10], 6))
+
+ZT = [0, 0, 0, 0x1, 0x2, 0x100002, 0x200002, 0x300002, 0x10000008, 0x8, 0x20, 0x200, 0x40,
+      0x4, 0x4000004, 0x20000, 0x120000, 0x300000, 0x4000, 0x800, 0x80, 0x10080, 0x40000,
+      0x1000000, 0x80000]
+PT = [0, 0, 0x1, 0x2, 0x44, 0x4, 0x20, 0x28, 0x40, 0x100, 0x800, 0x10000, 0x2000000,
+      0x40000, 0x4000, 0x40000000, 0x10000000, 0x8, 0x80000]
+CT = [0, 0, 1, 16, 2, 512, 4, 64, 2048, 0x4000, 8, 5]
+
+def zeus_map(r, mapsize=200):
+    N = 228 * 228; w = W(); w.raw(b'MAPS'); w.at(0x177c)
+    w.junk(r, 1000)
+    w.chunk(edges(r, N)); w.chunk(grid_bytes(runs(r, N, ZT), 'I'))
+    w.junk(r, N); w.u32(0); w.raw(bytes(r.randint(0, 255) for _ in range(N)))
+    w.junk(r, N); w.pad(60); w.u32(mapsize); w.pad(1984)
+    w.chunk(bytes(runs(r, N, [0, 10, 40, 99]))); w.pad(18628)
+    for n in (14400, 7516, 100, 36): w.junk(r, n)
+    w.pad(144); w.chunk(bytes(runs(r, N, [0, 0x10, 0x30, 0x40, 0x50, 0x60])))
+    return bytes(w.b)
+
+def walkers(r, count, size, mapsize, types, short_xy=True):
+    out = bytearray()
+    for i in range(count):
+        rec = bytearray(size)
+        if r.random() < 0.5:
+            struct.pack_into('<H', rec, 10, r.choice(types))
+            if short_xy: struct.pack_into('<HH', rec, 20, r.randrange(mapsize), r.randrange(mapsize))
+            else: struct.pack_into('<BB', rec, 20, r.randrange(mapsize), r.randrange(mapsize))
+        out += rec
+    return bytes(out)
+
+def buildings(r, count, size, rotpos, mapsize):
+    out = bytearray()
+    for i in range(count):
+        rec = bytearray(size)
+        if r.random() < 0.3:
+            s = r.choice([1, 1, 2, 3, 4, 6])
+            rec[3] = s
+            struct.pack_into('<HH', rec, 6, r.randrange(mapsize - s), r.randrange(mapsize - s))
+            struct.pack_into('<H', rec, 16, r.choice(list(range(1, 0xdb)) + [0x3f, 0x40, 0x83, 0xca, 0x2a, 0x2b, 0xe5, 0xd1]))
+            rec[rotpos] = r.randrange(4)
+        out += rec
+    return bytes(out)
+
+def zeus_sav(r, mapsize=200):
+    N = 228 * 228; w = W(); w.raw(b'SAVE'); w.at(0x1779)
+    w.junk(r, 19184); w.pad(8); w.junk(r, 12584); w.pad(188); w.u32(mapsize); w.pad(600)
+    w.raw(bytes([1])); w.pad(1383); w.junk(r, 14400); w.pad(18609)
+    w.chunk(edges(r, N)); w.junk(r, 2 * N); w.chunk(grid_bytes(runs(r, N, ZT), 'I'))
+    for n in (N, 2 * N, N, N): w.junk(r, n)
+    w.raw(bytes(r.randint(0, 255) for _ in range(N)))
+    for i in range(5): w.junk(r, N)
+    w.chunk(walkers(r, 2000, 388, mapsize, [6, 0x27, 0x43, 0x144, 0x45, 0x28, 0x3f, 1, 2]))
+    for n in (2000, 50000, 15600): w.junk(r, n)
+    w.pad(69); w.chunk(buildings(r, 4000, 280, 172, mapsize)); w.pad(352); w.junk(r, 60000)
+    w.pad(17974)
+    for n in (1000, 1000, 8000): w.junk(r, n)
+    w.pad(53783); w.raw(bytes(runs(r, N, [0, 10, 40, 99]))); w.pad(16); w.junk(r, 7516)
+    w.raw(bytes(runs(r, N, [0, 0x64, 255]))); w.pad(32); w.junk(r, 36); w.junk(r, 4 * N)
+    w.pad(39); w.junk(r, N); w.chunk(bytes(runs(r, N, [0, 0x10, 0x30, 0x40, 0x50, 0x60])))
+    return bytes(w.b)
+
+def pharaoh_map(r, mapsize=200):
+    N = 228 * 228; w = W(); w.raw(b'MAPS'); w.at(0x177c)
+    w.raw(grid_bytes(runs(r, N, [0, 0x3dd0, 0x3725, 5]), 'I')); w.raw(edges(r, N))
+    w.raw(grid_bytes(runs(r, N, PT), 'I')); w.pad(51984)
+    w.raw(bytes(r.randint(0, 255) for _ in range(N))); w.at(0x99C78); w.u32(mapsize)
+    w.pad(100)
+    return bytes(w.b)
+
+def pharaoh_sav(r, mapsize=200):
+    N = 228 * 228; w = W(); w.raw(b'SAVE'); w.at(0x177c)
+    w.chunk(grid_bytes(runs(r, N, [0, 0x3dd0, 0x3725, 5]), 'I')); w.chunk(edges(r, N))
+    w.junk(r, 2 * N); w.chunk(grid_bytes(runs(r, N, PT), 'I'))
+    for i in range(4): w.junk(r, N)
+    w.raw(bytes(r.randint(0, 255) for _ in range(N)))
+    for i in range(5): w.junk(r, N)
+    w.chunk(walkers(r, 2000, 388, mapsize, [0xb, 0x14, 0x54, 0x2b, 0x63, 1]))
+    for i in range(3): w.junk(r, 1000)
+    w.pad(12); w.junk(r, 500); w.pad(72)
+    w.chunk(buildings(r, 4000, 264, 170, mapsize))
+    w.pad(68); w.junk(r, 300); w.pad(704); w.u32(mapsize); w.pad(100)
+    return bytes(w.b)
+
+def c3_map(r, mapsize=160):
+    N = 162 * 162; w = W()
+    w.raw(grid_bytes(runs(r, N, [0, 0xa10, 0xb2f, 0xc69, 0x29c, 0x400]), 'H'))
+    w.b[4:8] = bytes(4)
+    w.raw(edges(r, N)); w.raw(grid_bytes(runs(r, N, CT), 'H')); w.pad(26244)
+    w.raw(bytes(r.randint(0, 255) for _ in range(N)))
+    w.at(0x335b4); w.u32(mapsize); w.at(0x33ad8); w.raw(bytes([r.randrange(3)])); w.pad(100)
+    return bytes(w.b)
+
+def c3_sav(r, mapsize=160):
+    N = 162 * 162; w = W(); w.u32(1); w.u32(1)
+    w.chunk(grid_bytes(runs(r, N, [0, 0xa10, 0xb2f, 0xc69, 0x29c, 0x400]), 'H'))
+    w.chunk(edges(r, N)); w.junk(r, 2 * N); w.chunk(grid_bytes(runs(r, N, CT), 'H'))
+    for i in range(4): w.junk(r, N)
+    w.raw(bytes(r.randint(0, 255) for _ in range(N)))
+    for i in range(5): w.junk(r, N)
+    w.chunk(walkers(r, 1000, 128, mapsize, [0x45, 0xb, 0x31, 0x2d, 1], short_xy=False))
+    w.u32(0); w.pad(1200); w.junk(r, 100); w.junk(r, 100); w.pad(12); w.junk(r, 100)
+    w.pad(70); w.junk(r, 100); w.pad(208); w.junk(r, 100); w.pad(788); w.u32(mapsize)
+    w.pad(1312); w.raw(bytes([r.randrange(3)])); w.pad(100)
+    return bytes(w.b)
+
+if __name__ == '__main__':
+    out = sys.argv[1] if len(sys.argv) > 1 else '.'
+    for name, f, mapsize, seed in (('zeus.map', zeus_map, 200, 73), ('zeus.sav', zeus_sav, 180, 40),
+                                   ('pharaoh.map', pharaoh_map, 200, 72), ('pharaoh.sav', pharaoh_sav, 160, 22),
+                                   ('c3.map', c3_map, 160, 27), ('c3.sav', c3_sav, 120, 77)):
+        open(os.path.join(out, name), 'wb').write(f(random.Random(seed), mapsize))
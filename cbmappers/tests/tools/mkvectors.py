@@ -0,0 +1,31 @@
+# Writes the PKWare test vectors in tests/data/pk: pairs of NN.raw and
+# NN.pk, compressed with pkimplode.py. The seeds are fixed, so running it
+# again gives the same files.
+#   python3 tests/tools/mkvectors.py tests/data/pk
+import os, random, sys
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from pkimplode import implode
+
+out = sys.argv[1] if len(sys.argv) > 1 else "."
+r = random.Random(7)
+for t in range(40):
+    kind = t % 4
+    n = r.choice([0, 1, 2, 5, 100, 4095, 4096, 4097, 9000, 30000, 200000])
+    if kind == 0: # random bytes
+        data = bytes(r.randint(0, 255) for _ in range(n))
+    elif kind == 1: # mostly zeroes, like the map layers
+        data = bytes(r.choice([0, 0, 0, 0, 1, 2, 0x20]) for _ in range(n))
+    elif kind == 2: # runs
+        data = bytearray()
+        while len(data) < n: data += bytes([r.randint(0, 3)]) * r.randint(1, 600)
+        data = bytes(data[:n])
+    else: # repeated patterns
+        data = bytearray()
+        while len(data) < n:
+            pat = bytes(r.randint(0, 255) for _ in range(r.choice([1, 2, 3, 4, 5, 7, 8, 16, 17, 31, 64])))
+            data += pat * r.randint(1, 80)
+        data = bytes(data[:n])
+    if n > 100000:
+        continue # too big to keep in the tree
+    open(os.path.join(out, "%02d.raw" % t), "wb").write(data)
+    open(os.path.join(out, "%02d.pk" % t), "wb").write(implode(data, [4, 5, 6][t % 3], seed=t))
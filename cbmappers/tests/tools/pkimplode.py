@@ -0,0 +1,86 @@
+# PKWare DCL "implode" encoder (binary mode, dynamic dict) for test data.
+import sys, random
+
+LEN_CODES = [  # (reading-order bits, base, extra)
+    ("101", 2, 0), ("11", 3, 0), ("100", 4, 0), ("011", 5, 0), ("0101", 6, 0),
+    ("0100", 7, 0), ("0011", 8, 0), ("00101", 9, 0), ("001000", 10, 0),
+    ("001001", 11, 0), ("00011", 12, 2), ("00010", 16, 3), ("000011", 24, 4),
+    ("000010", 40, 5), ("000001", 72, 6), ("0000001", 136, 7), ("0000000", 264, 8),
+]
+
+def off_code(v):
+    if v == 0: return "11"
+    small = {1: "1011", 2: "1010", 3: "10011", 4: "10010", 5: "10001", 6: "10000"}
+    if v in small: return small[v]
+    if 7 <= v <= 0x15: return "01" + format(0x16 - v, "04b")
+    if v == 0x16: return "0100001"
+    if v == 0x17: return "0100000"
+    if 0x18 <= v <= 0x1f: return "0011" + format(0x1f - v, "03b")
+    if 0x20 <= v <= 0x27: return "0010" + format(0x27 - v, "03b")
+    if 0x28 <= v <= 0x2f: return "0001" + format(0x2f - v, "03b")
+    return "0000" + format(0x3f - v, "04b")
+
+class BW:
+    def __init__(s): s.out = bytearray(); s.acc = 0; s.n = 0
+    def bits(s, st):
+        for ch in st: s.put(1 if ch == "1" else 0, 1)
+    def put(s, val, n):
+        s.acc |= (val & ((1 << n) - 1)) << s.n; s.n += n
+        while s.n >= 8:
+            s.out.append(s.acc & 0xff); s.acc >>= 8; s.n -= 8
+    def flush(s):
+        if s.n: s.out.append(s.acc & 0xff); s.acc = 0; s.n = 0
+
+def length_code(bw, L):
+    for st, base, extra in LEN_CODES:
+        if base <= L < base + (1 << extra):
+            bw.bits(st); bw.put(L - base, extra); return
+    raise ValueError(L)
+
+def implode(data, dict_bits=6, seed=None):
+    rnd = random.Random(seed)
+    dsize = 64 << dict_bits
+    bw = BW(); hdr = bytes([0, dict_bits])
+    i = 0; n = len(data)
+    heads = {}
+    while i < n:
+        best_l = 0; best_d = 0
+        key = bytes(data[i:i+3])
+        cands = heads.get(key, [])
+        for p in reversed(cands[-64:]):
+            d = i - p
+            if d > dsize: break
+            l = 0
+            while l < 518 and i + l < n and data[p + l] == data[i + l]: l += 1
+            if l > best_l: best_l, best_d = l, d
+        # also try distance-1..4 short matches for length 2
+        if best_l < 2 and i >= 1:
+            for d in range(1, min(i, 256) + 1):
+                if data[i-d:i-d+2] == data[i:i+2] and i + 1 < n:
+                    best_l, best_d = 2, d; break
+        if best_l == 2 and best_d > 256: best_l = 0
+        if seed is not None and best_l > 3 and rnd.random() < 0.2:
+            best_l = rnd.randint(3, best_l)
+        if best_l >= 2:
+            bw.put(1, 1); length_code(bw, best_l)
+            off = best_d - 1
+            lb = 2 if best_l == 2 else dict_bits
+            bw.bits(off_code(off >> lb)); bw.put(off & ((1 << lb) - 1), lb)
+            for k in range(best_l):
+                heads.setdefault(bytes(data[i+k:i+k+3]), []).append(i+k)
+            i += best_l
+        else:
+            bw.put(0, 1); bw.put(data[i], 8)
+            heads.setdefault(key, []).append(i)
+            i += 1
+    bw.put(1, 1); length_code_end(bw)
+    bw.flush()
+    return hdr + bytes(bw.out)
+
+def length_code_end(bw):
+    bw.bits("0000000"); bw.put(255, 8)
+
+if __name__ == "__main__":
+    src = open(sys.argv[1], "rb").read()
+    bits = int(sys.argv[3]) if len(sys.argv) > 3 else 6
+    open(sys.argv[2], "wb").write(implode(src, bits))
@@ -19,20 +19,19 @@
 #include "zeusfile.h"
 #include "pkwareinputstream.h"
 #include <fstream>
+#include <string.h>
 
 using namespace std;
 
-ZeusFile::ZeusFile(string filename) {
-	in = new ifstream();
+ZeusFile::ZeusFile(string filename, Arena *arena) {
+	this->arena = arena;
+	in.reset(new ifstream());
 	retrievedMaps = numMaps = 0;
 	in->open(filename.c_str(), ios::in | ios::binary);
 	if (!in->is_open()) {
 		throw "Can't read file";
 	}
-}
-
-ZeusFile::~ZeusFile() {
-	delete in;
+	file.reset(new MappedFile(filename));
 }
 
 bool ZeusFile::isAdventure() {
@@ -78,19 +77,26 @@ int ZeusFile::getNumMaps() {
 	return numMaps;
 }
 
-PNGImage *ZeusFile::getImage() {
+unique_ptr<IndexedPNGImage> ZeusFile::getImage() {
+	unique_ptr<MapModel> model = getModel();
+	return drawModel(model.get());
+}
+
+unique_ptr<MapModel> ZeusFile::getModel() {
 	if (retrievedMaps >= numMaps) {
 		throw "No maps left";
 	}
-	Grid<unsigned int> *terrain = NULL;
-	Grid<unsigned char> *edges = NULL, *random = NULL, *fertile = NULL,
-		*scrub = NULL, *marble = NULL;
-	
-	Walker *walkers = NULL;
-	Building *buildings = NULL;
+	GridView<unsigned int> terrain;
+	GridView<unsigned char> edges, random, fertile, scrub, marble;
 	int mapsize;
 	bool is_poseidon = false;
 	
+	// Compressed chunks are only located while walking through the file,
+	// and decompressed all at once afterwards. The views point into it.
+	ChunkDecoder chunks(0, arena);
+	int c_edges, c_terrain, c_fertile = -1, c_scrub,
+		c_walkers = -1, c_buildings = -1;
+	
 	if (filetype == TYPE_SAVEDGAME) {
 		retrievedMaps++;
 		// Saved game
@@ -115,22 +121,22 @@ PNGImage *ZeusFile::getImage() {
 		in->seekg(1384, ios::cur);
 		skipCompressed(); // 14400 bytes with unknown purpose
 		in->seekg(18609, ios::cur); // unknown purpose
-		edges = readCompressedByteGrid(); // edges
+		c_edges = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE); // edges
 		skipCompressed(); // short grid with all zeroes
-		terrain = readCompressedIntGrid(); // Terrain info: 01 = trees, etc
+		c_terrain = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE * 4); // Terrain info: 01 = trees, etc
 		skipCompressed(); // byte grid with all zeroes
 		skipCompressed(); // short grid with ID numbers: perhaps which walker is where or sth
 		skipCompressed(); // byte grid: 00 / 20
 		skipCompressed(); // byte grid: all zeroes
 		
 		// onwards to the interesting stuff:
-		random = readByteGrid();
-		walkers = getWalkers(); // includes 5 misc grids
+		random = viewByteGrid();
+		c_walkers = queueWalkers(&chunks); // includes 5 misc grids
 		skipCompressed(); // not of proper length: 2000
 		skipCompressed(); // not of proper length: 500000
 		skipCompressed(); // 15600
 		in->seekg(69, ios::cur);
-		buildings = getBuildings(); // buildings tables
+		c_buildings = queueCompressed(&chunks, MAX_BUILDINGS * 280); // buildings tables
 		in->seekg(352, ios::cur);
 		skipCompressed(); // 60000
 		in->seekg(17974, ios::cur);
@@ -138,17 +144,17 @@ PNGImage *ZeusFile::getImage() {
 		skipCompressed(); // 1000
 		skipCompressed(); // 8000
 		in->seekg(53783, ios::cur); // 53783
-		fertile = readByteGrid();
+		fertile = viewByteGrid();
 		in->seekg(16, ios::cur);
 		skipCompressed(); // 75168 bytes
 		// marble thingy
-		marble = readByteGrid(); // relates to marble quarries & sheep & goats
+		marble = viewByteGrid(); // relates to marble quarries & sheep & goats
 		in->seekg(32, ios::cur);
 		skipCompressed(); // 36 bytes
 		skipCompressed(); // int grid for "intelligent" maintenance officers
 		in->seekg(39, ios::cur);
 		skipCompressed(); // another mysterious byte grid (zeroes &)
-		scrub = readCompressedByteGrid(); // this really IS the scrub
+		c_scrub = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE); // this really IS the scrub
 		/*
 		in->seekg(4, ios::cur);
 		bgrid = readCompressedByteGrid(); // elevation level, including edges
@@ -164,32 +170,39 @@ PNGImage *ZeusFile::getImage() {
 		// Read scenario info
 		in->seekg(0x1778, ios::cur);
 		skipCompressed(); // buildings grid: there are no placable buildings
-		edges = readCompressedByteGrid();
-		terrain = readCompressedIntGrid();
+		c_edges = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE);
+		c_terrain = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE * 4);
 		skipCompressed(); // byte grid: 00 or 20
 		readInt(); // indicating start of random block (or perhaps "uncompressed" indicator?)
-		random = readByteGrid();
+		random = viewByteGrid();
 		skipCompressed(); // byte grid: all zeroes
 		in->seekg(60, ios::cur);
 		mapsize = readInt(); // Poseidon or not doesn't matter here
 		
 		// Sanity check
 		if (mapsize > MAX_MAPSIZE) {
-			delete edges;
-			delete terrain;
-			delete random;
 			throw "Invalid map size";
 		}
 		
 		in->seekg(1984, ios::cur);
-		fertile = readCompressedByteGrid(); // meadow, 0-99
+		c_fertile = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE); // meadow, 0-99
 		in->seekg(18628, ios::cur);
 		skipCompressed(); // not of proper length: 14400
 		skipCompressed(); // not of proper length: 75168
 		skipCompressed(); // byte grid: all ff's (counterpart of marble grid in sav?
 		skipCompressed(); // 36 bytes
 		in->seekg(144, ios::cur);
-		scrub = readCompressedByteGrid();
+		c_scrub = queueCompressed(&chunks, MAX_MAPSIZE * MAX_MAPSIZE);
+	}
+	
+	if (!chunks.run()) {
+		throw PKException("Invalid compressed data");
+	}
+	edges   = viewByteGrid(chunks.data(c_edges));
+	terrain = viewIntGrid(chunks.data(c_terrain));
+	scrub   = viewByteGrid(chunks.data(c_scrub));
+	if (c_fertile != -1) {
+		fertile = viewByteGrid(chunks.data(c_fertile));
 	}
 	
 	// Extra sanity check though it should be ok by now
@@ -197,9 +210,37 @@ PNGImage *ZeusFile::getImage() {
 		throw "Invalid map size";
 	}
 	
+	unique_ptr<MapModel> model(new MapModel(MAX_MAPSIZE, mapsize, MAP_DIAMOND, arena));
+	MapModel::load(&model->edges, edges);
+	MapModel::load(&model->terrain, terrain);
+	MapModel::load(&model->random, random);
+	MapModel::load(&model->meadow, fertile);
+	MapModel::load(&model->scrub, scrub);
+	if (!marble.empty()) {
+		MapModel::load(&model->marble, marble);
+	} else {
+		model->marble.fill(255);
+	}
+	if (c_walkers != -1) {
+		readWalkers(chunks.data(c_walkers), &model->walkers);
+	}
+	if (c_buildings != -1) {
+		readBuildings(chunks.data(c_buildings), &model->buildings);
+	}
+	model->expansion = is_poseidon;
+	return model;
+}
+
+/**
+* Draws the minimap of a parsed map
+*/
+unique_ptr<IndexedPNGImage> ZeusFile::drawModel(const MapModel *model) {
+	int mapsize = model->mapsize;
+	
 	// Transform it to something useful
-	colours = new ZeusColours(); // all climates have the same minimap colours
-	PNGImage *img = new PNGImage(mapsize, mapsize);
+	colours.reset(new ZeusColours()); // all climates have the same minimap colours
+	unique_ptr<IndexedPNGImage> img(new IndexedPNGImage(mapsize, mapsize,
+		colours->palette(), colours->paletteSize(), arena));
 	int half = MAX_MAPSIZE / 2;
 	int border = (MAX_MAPSIZE - mapsize) / 2;
 	int max = border + mapsize;
@@ -212,61 +253,54 @@ PNGImage *ZeusFile::getImage() {
 	for (int y = border; y < max; y++) {
 		start = (y < half) ? (border + half - y - 1) : (border + y - half);
 		end   = (y < half) ? (half + y + 1 - border) : (3*half - y - border);
+		// Rows of the layers start at x = start
+		const unsigned int *terrain_row = model->terrain.row(y);
+		const unsigned char *random_row = model->random.row(y);
+		const unsigned char *meadow_row = model->meadow.row(y);
+		const unsigned char *scrub_row = model->scrub.row(y);
+		const unsigned char *marble_row = model->marble.row(y);
 		for (int x = start; x < end; x++) {
-			t_terrain  = terrain->get(x, y);
-			t_random = random->get(x, y);
-			t_meadow = fertile->get(x, y);
-			t_scrub = scrub->get(x, y);
-			t_marble = (marble) ? marble->get(x, y) : 255;
+			t_terrain  = terrain_row[x - start];
+			t_random = random_row[x - start];
+			t_meadow = meadow_row[x - start];
+			t_scrub = scrub_row[x - start];
+			t_marble = marble_row[x - start];
 			
 			getTerrainColours(t_terrain, t_random, t_meadow, t_scrub, t_marble, &c1, &c2);
 			
 			// Set pixel colours
 			getBitmapCoordinates(x-border, y-border, mapsize, &coords[0], &coords[1]);
-			img->setRGB(coords[0], coords[1], c1);
-			img->setRGB(coords[0]+1, coords[1], c2);
+			img->setIndex(coords[0], coords[1], c1);
+			img->setIndex(coords[0]+1, coords[1], c2);
 		}
 	}
-	delete terrain;
-	delete random;
-	delete fertile;
-	delete scrub;
-	if (marble) delete marble;
-	
-	if (buildings) {
-		placeBuildings(img, buildings, edges, mapsize, is_poseidon);
-		delete buildings;
-	}
-	delete edges;
+	placeBuildings(img.get(), model);
 	
-	if (walkers) {
-		// Get walkers
-		int colour;
-		for (int i = 0; i < MAX_WALKERS; i++) {
-			// Check for not shown walkers
-			if (walkers[i].type == 0x6 || walkers[i].type == 0x27 // part immigrant, tower sentry
-			|| walkers[i].type == 0x2E || walkers[i].type == 0x2B) { // wall sentry, horse in ranch
-				continue;
-			} else if ((walkers[i].type & 0xff) == 0x43) {
-				colour = colours->colour(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_GOD);
-			} else if ((walkers[i].type & 0xff) == 0x44) {
-				colour = colours->colour(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_MONSTER);
-			} else if ((walkers[i].type & 0xff) == 0x45) {
-				colour = colours->colour(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_HERO);
-			} else if ((walkers[i].type >= 0x28 && walkers[i].type <= 0x2a) // enemy soldiers
-			|| walkers[i].type == 0x3f || walkers[i].type == 0x40) { // enemy transport/warship
-				colour = colours->colour(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_ENEMY);
-			} else {
-				//colour = walkers[i].type;
-				colour = colours->colour(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_HUMAN);
-			}
-			getBitmapCoordinates(walkers[i].x, walkers[i].y, mapsize, &coords[0], &coords[1]);
-			img->setRGB(coords[0], coords[1], colour);
-			img->setRGB(coords[0]+1, coords[1], colour);
+	// Only saved games have walkers
+	int colour;
+	for (unsigned int i = 0; i < model->walkers.size(); i++) {
+		const Walker &walker = model->walkers[i];
+		// Check for not shown walkers
+		if (walker.type == 0x6 || walker.type == 0x27 // part immigrant, tower sentry
+		|| walker.type == 0x2E || walker.type == 0x2B) { // wall sentry, horse in ranch
+			continue;
+		} else if ((walker.type & 0xff) == 0x43) {
+			colour = colours->index(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_GOD);
+		} else if ((walker.type & 0xff) == 0x44) {
+			colour = colours->index(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_MONSTER);
+		} else if ((walker.type & 0xff) == 0x45) {
+			colour = colours->index(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_HERO);
+		} else if ((walker.type >= 0x28 && walker.type <= 0x2a) // enemy soldiers
+		|| walker.type == 0x3f || walker.type == 0x40) { // enemy transport/warship
+			colour = colours->index(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_ENEMY);
+		} else {
+			//colour = walker.type;
+			colour = colours->index(ZeusColours::MAP_SPRITES, ZeusColours::SPRITE_HUMAN);
 		}
-		delete walkers;
+		getBitmapCoordinates(walker.x, walker.y, mapsize, &coords[0], &coords[1]);
+		img->setIndex(coords[0], coords[1], colour);
+		img->setIndex(coords[0]+1, coords[1], colour);
 	}
-	delete colours;
 	
 	//img->write("out.png");
 	return img;
@@ -275,23 +309,21 @@ PNGImage *ZeusFile::getImage() {
 /**
 * Goes through the list of buildings and places them on the image
 * @param img       Image to write on
-* @param buildings Building list
-* @param edges     Edge information
-* @param mapsize   Total size of the image
-* @param is_poseidon Whether this is Poseidon or vanilla Zeus
+* @param model     Map with the buildings and edges
 */
-void ZeusFile::placeBuildings(PNGImage *img, Building *buildings,
-		Grid<unsigned char> *edges, int mapsize, bool is_poseidon) {
+void ZeusFile::placeBuildings(IndexedPNGImage *img, const MapModel *model) {
 	int cid, num;
-	Building *b;
+	Building building, *b = &building;
+	const MapGrid<unsigned char> *edges = &model->edges;
+	int mapsize = model->mapsize;
+	bool is_poseidon = model->expansion;
 	int sizeX, sizeY;
 	bool reverse;
-	for (int i = 0; i < MAX_BUILDINGS; i++) {
-		if (buildings[i].type == 0) {
-			continue;
-		}
+	for (unsigned int i = 0; i < model->buildings.size(); i++) {
+		// A copy, the special cases below move some buildings around
+		building = model->buildings[i];
+		
 		// Figure out building colour ID
-		b = &buildings[i];
 		
 		sizeX = sizeY = b->size;
 		num = 0;
@@ -354,14 +386,14 @@ void ZeusFile::placeBuildings(PNGImage *img, Building *buildings,
 			// the road itself as well
 			if (b->rotation) {
 				placeBuilding(img, edges, mapsize, b->x + 3, b->y, 2, 2,
-					colours->colour(cid, 0), colours->colour(cid, 1), false);
+					colours->index(cid, 0), colours->index(cid, 1), false);
 				placeBuilding(img, edges, mapsize, b->x + 2, b->y, 1, 2,
-					colours->colour(cid, 0), colours->colour(cid, 1), false);
+					colours->index(cid, 0), colours->index(cid, 1), false);
 			} else {
 				placeBuilding(img, edges, mapsize, b->x, b->y + 3, 2, 2,
-					colours->colour(cid, 0), colours->colour(cid, 1), false);
+					colours->index(cid, 0), colours->index(cid, 1), false);
 				placeBuilding(img, edges, mapsize, b->x, b->y + 2, 2, 1,
-					colours->colour(cid, 0), colours->colour(cid, 1), false);
+					colours->index(cid, 0), colours->index(cid, 1), false);
 			}
 		}
 		
@@ -372,7 +404,7 @@ void ZeusFile::placeBuildings(PNGImage *img, Building *buildings,
 			reverse = false;
 		}
 		placeBuilding(img, edges, mapsize, b->x, b->y, sizeX, sizeY,
-			colours->colour(cid, num), colours->colour(cid, num+1), reverse);
+			colours->index(cid, num), colours->index(cid, num+1), reverse);
 	}
 }
 
@@ -390,14 +422,14 @@ void ZeusFile::placeBuildings(PNGImage *img, Building *buildings,
 * @param c2      Colour 2 -- used for top & right edge
 * @param reverse Whether to reverse the two colours for 1x1 buildings
 */
-void ZeusFile::placeBuilding(PNGImage *img, Grid<unsigned char> *edges,
+void ZeusFile::placeBuilding(IndexedPNGImage *img, const MapGrid<unsigned char> *edges,
 		int mapsize, int posX, int posY,
 		int sizeX, int sizeY, int c1, int c2, bool reverse) {
 	int coords[2];
 	if (sizeX == 1 && sizeY == 1) {
 		getBitmapCoordinates(posX, posY, mapsize, &coords[0], &coords[1]);
-		img->setRGB(coords[0], coords[1], reverse ? c2 : c1);
-		img->setRGB(coords[0]+1, coords[1], reverse ? c1 : c2);
+		img->setIndex(coords[0], coords[1], reverse ? c2 : c1);
+		img->setIndex(coords[0]+1, coords[1], reverse ? c1 : c2);
 	} else {
 		int offset = (MAX_MAPSIZE - mapsize) / 2;
 		for (int y = 0; y < sizeY; y++) {
@@ -405,16 +437,16 @@ void ZeusFile::placeBuilding(PNGImage *img, Grid<unsigned char> *edges,
 				getBitmapCoordinates(posX + x, posY + y, mapsize, &coords[0], &coords[1]);
 				unsigned char edge = edges->get(offset+posX+x, offset+posY+y);
 				if (edge == 64) {
-					img->setRGB(coords[0], coords[1], reverse ? c2 : c1);
-					img->setRGB(coords[0]+1, coords[1], reverse ? c1 : c2);
+					img->setIndex(coords[0], coords[1], reverse ? c2 : c1);
+					img->setIndex(coords[0]+1, coords[1], reverse ? c1 : c2);
 				} else { // is not 1-tile building
 					unsigned char edge_right = edges->get(offset+posX+x+1, offset+posY+y);
-					img->setRGB(coords[0], coords[1], c1);
+					img->setIndex(coords[0], coords[1], c1);
 					if (edge < 8 || edge_right != (edge & 0x3f) + 1 // top edge OR right edge
 						|| (sizeX == 6 && x == 2) || (sizeY == 6 && y == 3)) { // 6x6 split
-						img->setRGB(coords[0]+1, coords[1], c2);
+						img->setIndex(coords[0]+1, coords[1], c2);
 					} else {
-						img->setRGB(coords[0]+1, coords[1], c1);
+						img->setIndex(coords[0]+1, coords[1], c1);
 					}
 				}
 			}
@@ -429,238 +461,151 @@ void ZeusFile::getTerrainColours(unsigned int terrain, unsigned char random,
 		unsigned char meadow, unsigned char scrub, unsigned char marble,
 		int *c1, int *c2) {
 	if (terrain & 0x80000) {
-		*c1 = *c2 = colours->colour(ZeusColours::MAP_BACKGROUND, 0);
+		*c1 = *c2 = colours->index(ZeusColours::MAP_BACKGROUND, 0);
 		return;
 	}
 	
 	int num3 = random & 3;
 	if (terrain & 0x1) { // tree/shrub
-		*c1 = colours->colour(ZeusColours::MAP_TREE1, num3);
-		*c2 = colours->colour(ZeusColours::MAP_TREE2, num3);
+		*c1 = colours->index(ZeusColours::MAP_TREE1, num3);
+		*c2 = colours->index(ZeusColours::MAP_TREE2, num3);
 	} else if (terrain & 0x2) { // rock or ore-bearing rock
 		if ((terrain & 0x300002) == 0x100002) { // copper ore
-			*c1 = colours->colour(ZeusColours::MAP_COPPER1, num3);
-			*c2 = colours->colour(ZeusColours::MAP_COPPER2, num3);
+			*c1 = colours->index(ZeusColours::MAP_COPPER1, num3);
+			*c2 = colours->index(ZeusColours::MAP_COPPER2, num3);
 		} else if ((terrain & 0x300002) == 0x200002) { // silver ore
-			*c1 = colours->colour(ZeusColours::MAP_SILVER1, num3);
-			*c2 = colours->colour(ZeusColours::MAP_SILVER2, num3);
+			*c1 = colours->index(ZeusColours::MAP_SILVER1, num3);
+			*c2 = colours->index(ZeusColours::MAP_SILVER2, num3);
 		} else { // normal (0x2) or cliff rock (0x300002) 
 			// or black marble quarry (0x120000) ??
-			*c1 = colours->colour(ZeusColours::MAP_ROCK1, num3);
-			*c2 = colours->colour(ZeusColours::MAP_ROCK2, num3);
+			*c1 = colours->index(ZeusColours::MAP_ROCK1, num3);
+			*c2 = colours->index(ZeusColours::MAP_ROCK2, num3);
 		}
 	} else if (terrain & 0x10000000 && (!(terrain & 0x8) || terrain & 0x40)) { // sanctuary or pyramid
-		*c1 = colours->colour(ZeusColours::MAP_SANCTUARY, 2);
-		*c2 = colours->colour(ZeusColours::MAP_SANCTUARY, 3);
+		*c1 = colours->index(ZeusColours::MAP_SANCTUARY, 2);
+		*c2 = colours->index(ZeusColours::MAP_SANCTUARY, 3);
 	} else if (terrain & 0x8) { // building, fill in for boulevard or avenue
-		*c1 = colours->colour(ZeusColours::MAP_AESTHETICS, 1);
-		*c2 = colours->colour(ZeusColours::MAP_AESTHETICS, 0);
+		*c1 = colours->index(ZeusColours::MAP_AESTHETICS, 1);
+		*c2 = colours->index(ZeusColours::MAP_AESTHETICS, 0);
 	} else if (terrain & 0x20) { // park
-		*c1 = colours->colour(ZeusColours::MAP_AESTHETICS, 4);
-		*c2 = colours->colour(ZeusColours::MAP_AESTHETICS, 5);
+		*c1 = colours->index(ZeusColours::MAP_AESTHETICS, 4);
+		*c2 = colours->index(ZeusColours::MAP_AESTHETICS, 5);
 	} else if (terrain & 0x200) { // elevation
-		*c1 = colours->colour(ZeusColours::MAP_ELEVATION1, num3);
-		*c2 = colours->colour(ZeusColours::MAP_ELEVATION2, num3);
+		*c1 = colours->index(ZeusColours::MAP_ELEVATION1, num3);
+		*c2 = colours->index(ZeusColours::MAP_ELEVATION2, num3);
 	} else if (terrain & 0x40) { // road
-		*c1 = colours->colour(ZeusColours::MAP_ROAD, 0);
-		*c2 = colours->colour(ZeusColours::MAP_ROAD, 1);
+		*c1 = colours->index(ZeusColours::MAP_ROAD, 0);
+		*c2 = colours->index(ZeusColours::MAP_ROAD, 1);
 	} else if (terrain & 0x4) { // water
 		if (terrain & 0x4000000) { // deep water
-			*c1 = colours->colour(ZeusColours::MAP_DEEPWATER1, num3);
-			*c2 = colours->colour(ZeusColours::MAP_DEEPWATER2, num3);
+			*c1 = colours->index(ZeusColours::MAP_DEEPWATER1, num3);
+			*c2 = colours->index(ZeusColours::MAP_DEEPWATER2, num3);
 		} else { // shallow water
-			*c1 = colours->colour(ZeusColours::MAP_WATER1, num3);
-			*c2 = colours->colour(ZeusColours::MAP_WATER2, num3);
+			*c1 = colours->index(ZeusColours::MAP_WATER1, num3);
+			*c2 = colours->index(ZeusColours::MAP_WATER2, num3);
 		}
 	} else if (terrain & 0x20000) { // marble quarry
 		if (terrain & 0x100000) { // black marble
 			if (marble == 255) {
-				*c1 = colours->colour(ZeusColours::MAP_QUARRY1, 2);
-				*c2 = colours->colour(ZeusColours::MAP_QUARRY2, 2);
+				*c1 = colours->index(ZeusColours::MAP_QUARRY1, 2);
+				*c2 = colours->index(ZeusColours::MAP_QUARRY2, 2);
 			} else if (marble == 0x64) {
-				*c1 = colours->colour(ZeusColours::MAP_QUARRY1, 3);
-				*c2 = colours->colour(ZeusColours::MAP_QUARRY2, 3);
+				*c1 = colours->index(ZeusColours::MAP_QUARRY1, 3);
+				*c2 = colours->index(ZeusColours::MAP_QUARRY2, 3);
 			} else { // marble == 0
-				*c1 = colours->colour(ZeusColours::MAP_QUARRY1, 5);
-				*c2 = colours->colour(ZeusColours::MAP_QUARRY2, 5);
+				*c1 = colours->index(ZeusColours::MAP_QUARRY1, 5);
+				*c2 = colours->index(ZeusColours::MAP_QUARRY2, 5);
 			}
 		} else { // normal marble
 			if (marble == 255) {
-				*c1 = colours->colour(ZeusColours::MAP_QUARRY1, num3 & 1);
-				*c2 = colours->colour(ZeusColours::MAP_QUARRY2, num3 & 1);
+				*c1 = colours->index(ZeusColours::MAP_QUARRY1, num3 & 1);
+				*c2 = colours->index(ZeusColours::MAP_QUARRY2, num3 & 1);
 			} else if (marble == 0x64) {
-				*c1 = colours->colour(ZeusColours::MAP_QUARRY1, 2 + (num3 & 1));
-				*c2 = colours->colour(ZeusColours::MAP_QUARRY2, 2 + (num3 & 1));
+				*c1 = colours->index(ZeusColours::MAP_QUARRY1, 2 + (num3 & 1));
+				*c2 = colours->index(ZeusColours::MAP_QUARRY2, 2 + (num3 & 1));
 			} else {
-				*c1 = colours->colour(ZeusColours::MAP_QUARRY1, 4 + (num3 & 1));
-				*c2 = colours->colour(ZeusColours::MAP_QUARRY2, 4 + (num3 & 1));
+				*c1 = colours->index(ZeusColours::MAP_QUARRY1, 4 + (num3 & 1));
+				*c2 = colours->index(ZeusColours::MAP_QUARRY2, 4 + (num3 & 1));
 			}
 		}
 	} else if ((terrain & 0x300000) == 0x300000) { // orichalc
-		*c1 = colours->colour(ZeusColours::MAP_ORICHALC1, num3);
-		*c2 = colours->colour(ZeusColours::MAP_ORICHALC2, num3);
+		*c1 = colours->index(ZeusColours::MAP_ORICHALC1, num3);
+		*c2 = colours->index(ZeusColours::MAP_ORICHALC2, num3);
 	} else if (terrain & 0x4000) { // wall
-		*c1 = colours->colour(ZeusColours::MAP_WALL, 0);
-		*c2 = colours->colour(ZeusColours::MAP_WALL, 1);
+		*c1 = colours->index(ZeusColours::MAP_WALL, 0);
+		*c2 = colours->index(ZeusColours::MAP_WALL, 1);
 	} else if (terrain & 0x800) { // meadow
 		meadow >>= 5;
-		*c1 = colours->colour(ZeusColours::MAP_FERTILE1, meadow);
-		*c2 = colours->colour(ZeusColours::MAP_FERTILE2, meadow);
+		*c1 = colours->index(ZeusColours::MAP_FERTILE1, meadow);
+		*c2 = colours->index(ZeusColours::MAP_FERTILE2, meadow);
 	} else if (terrain & 0x80) { // beach / beach edge / scrub
 		if (terrain & 0x10000) { // beach sand
-			*c1 = colours->colour(ZeusColours::MAP_BEACH1, random & 7);
-			*c2 = colours->colour(ZeusColours::MAP_BEACH2, random & 7);
+			*c1 = colours->index(ZeusColours::MAP_BEACH1, random & 7);
+			*c2 = colours->index(ZeusColours::MAP_BEACH2, random & 7);
 		} else { // beach edge OR scrub
 			if (scrub <= 0x18) {
-				*c1 = colours->colour(ZeusColours::MAP_BEACH_EDGE1, random & 1);
-				*c2 = colours->colour(ZeusColours::MAP_BEACH_EDGE2, random & 1);
+				*c1 = colours->index(ZeusColours::MAP_BEACH_EDGE1, random & 1);
+				*c2 = colours->index(ZeusColours::MAP_BEACH_EDGE2, random & 1);
 			} else if (scrub <= 0x38) {
-				*c1 = colours->colour(ZeusColours::MAP_BEACH_EDGE1, 1);
-				*c2 = colours->colour(ZeusColours::MAP_BEACH_EDGE2, 1);
+				*c1 = colours->index(ZeusColours::MAP_BEACH_EDGE1, 1);
+				*c2 = colours->index(ZeusColours::MAP_BEACH_EDGE2, 1);
 			} else if (scrub <= 0x48) {
-				*c1 = colours->colour(ZeusColours::MAP_BEACH_EDGE1, (random & 1) + 1);
-				*c2 = colours->colour(ZeusColours::MAP_BEACH_EDGE2, (random & 1) + 1);
+				*c1 = colours->index(ZeusColours::MAP_BEACH_EDGE1, (random & 1) + 1);
+				*c2 = colours->index(ZeusColours::MAP_BEACH_EDGE2, (random & 1) + 1);
 			} else if (scrub <= 0x50) {
-				*c1 = colours->colour(ZeusColours::MAP_BEACH_EDGE1, (random & 1) + 2);
-				*c2 = colours->colour(ZeusColours::MAP_BEACH_EDGE2, (random & 1) + 2);
+				*c1 = colours->index(ZeusColours::MAP_BEACH_EDGE1, (random & 1) + 2);
+				*c2 = colours->index(ZeusColours::MAP_BEACH_EDGE2, (random & 1) + 2);
 			} else {
-				*c1 = colours->colour(ZeusColours::MAP_BEACH_EDGE1, (random & 1) + 3);
-				*c2 = colours->colour(ZeusColours::MAP_BEACH_EDGE2, (random & 1) + 3);
+				*c1 = colours->index(ZeusColours::MAP_BEACH_EDGE1, (random & 1) + 3);
+				*c2 = colours->index(ZeusColours::MAP_BEACH_EDGE2, (random & 1) + 3);
 			}
 		}
 	} else if (terrain & 0x40000) { // marshland
-		*c1 = colours->colour(ZeusColours::MAP_MARSH, (random & 4) >> 2);
-		*c2 = colours->colour(ZeusColours::MAP_MARSH, ((random & 4) >> 2) + 2);
+		*c1 = colours->index(ZeusColours::MAP_MARSH, (random & 4) >> 2);
+		*c2 = colours->index(ZeusColours::MAP_MARSH, ((random & 4) >> 2) + 2);
 	} else if (terrain & 0x1000000) { // molten lava
-		*c1 = colours->colour(ZeusColours::MAP_LAVA, (random % 2));
-		*c2 = colours->colour(ZeusColours::MAP_LAVA, (random % 2) + 2);
+		*c1 = colours->index(ZeusColours::MAP_LAVA, (random % 2));
+		*c2 = colours->index(ZeusColours::MAP_LAVA, (random % 2) + 2);
 	} else { // empty land
-		*c1 = colours->colour(ZeusColours::MAP_EMPTY1, (random >> 1) % 4);
-		*c2 = colours->colour(ZeusColours::MAP_EMPTY2, (random >> 1) % 4);
+		*c1 = colours->index(ZeusColours::MAP_EMPTY1, (random >> 1) % 4);
+		*c2 = colours->index(ZeusColours::MAP_EMPTY2, (random >> 1) % 4);
 	}
 }
 
 /**
-* Reads a compressed byte grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on a byte grid in decompressed data
 */
-Grid<unsigned char> *ZeusFile::readCompressedByteGrid() {
-	int length = readInt();
-	Grid<unsigned char> *g = new Grid<unsigned char>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readByte());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned char> ZeusFile::viewByteGrid(const unsigned char *data) {
+	return GridView<unsigned char>(data, MAX_MAPSIZE, MAX_MAPSIZE);
 }
 
 /**
-* Reads a compressed short grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on an uncompressed byte grid in the file.
 */
-Grid<unsigned short> *ZeusFile::readCompressedShortGrid() {
-	int length = readInt();
-	Grid<unsigned short> *g = new Grid<unsigned short>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readShort());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned char> ZeusFile::viewByteGrid() {
+	return viewByteGrid(getUncompressedData(MAX_MAPSIZE * MAX_MAPSIZE));
 }
 
 /**
-* Reads a compressed int grid from the stream. Compressed chunks
-* consist of a length followed by a compressed chunk of that length
+* Returns a view on an int grid in decompressed data
 */
-Grid<unsigned int> *ZeusFile::readCompressedIntGrid() {
-	int length = readInt();
-	Grid<unsigned int> *g = new Grid<unsigned int>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		for (int y = 0; y < MAX_MAPSIZE; y++) {
-			for (int x = 0; x < MAX_MAPSIZE; x++) {
-				g->set(x, y, pk.readInt());
-			}
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete g;
-		throw;
-	}
-	return g;
+GridView<unsigned int> ZeusFile::viewIntGrid(const unsigned char *data) {
+	return GridView<unsigned int>(data, MAX_MAPSIZE, MAX_MAPSIZE);
 }
 
 /**
-* Reads an uncompressed byte grid from the stream.
+* Returns a view on an uncompressed int grid in the file.
 */
-Grid<unsigned char> *ZeusFile::readByteGrid() {
-	Grid<unsigned char> *g = new Grid<unsigned char>(MAX_MAPSIZE, MAX_MAPSIZE);
-	char c;
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			in->read(&c, 1);
-			g->set(x, y, (unsigned char)c);
-		}
-	}
-	return g;
+GridView<unsigned int> ZeusFile::viewIntGrid() {
+	return viewIntGrid(getUncompressedData(MAX_MAPSIZE * MAX_MAPSIZE * 4));
 }
 
 /**
-* Reads an uncompressed short grid from the stream.
-*/
-Grid<unsigned short> *ZeusFile::readShortGrid() {
-	Grid<unsigned short> *g = new Grid<unsigned short>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			g->set(x, y, readShort());
-		}
-	}
-	return g;
-}
-
-/**
-* Reads an uncompressed int grid from the stream.
-*/
-Grid<unsigned int> *ZeusFile::readIntGrid() {
-	Grid<unsigned int> *g = new Grid<unsigned int>(MAX_MAPSIZE, MAX_MAPSIZE);
-	
-	for (int y = 0; y < MAX_MAPSIZE; y++) {
-		for (int x = 0; x < MAX_MAPSIZE; x++) {
-			g->set(x, y, readInt());
-		}
-	}
-	return g;
-}
-
-/**
-* Gets the walker info from the saved game, which is buried after
+* Queues the walker info from the saved game, which is buried after
 * a few "useless" compressed chunks.
+* @return int Index of the walker chunk in `chunks'
 */
-Walker * ZeusFile::getWalkers() {
+int ZeusFile::queueWalkers(ChunkDecoder *chunks) {
 	// Assume random data has been read already
 	// Which is followed by some more compressed data blocks (appeal + zeroesx3 + possibly fire/damage)
 	for (int i = 0; i < 5; i++) {
@@ -668,56 +613,47 @@ Walker * ZeusFile::getWalkers() {
 	}
 	
 	// Next come the walkers in compressed format
-	Walker *walkers = new Walker[MAX_WALKERS];
-	int length = readInt();
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		// Walker entry = 388 bytes
-		for (int i = 0; i < MAX_WALKERS; i++) {
-			pk.skip(10);
-			walkers[i].type = pk.readShort();
-			pk.skip(8);
-			walkers[i].x = pk.readShort();
-			walkers[i].y = pk.readShort();
-			pk.skip(364);
-		}
-		pk.empty();
-	} catch (PKException) {
-		delete walkers;
-		throw;
+	return queueCompressed(chunks, MAX_WALKERS * 388);
+}
+
+/**
+* Reads the walker info from the decompressed walker table
+*/
+void ZeusFile::readWalkers(const unsigned char *data, WalkerTable *walkers) {
+	walkers->resize(MAX_WALKERS);
+	
+	// Walker entry = 388 bytes
+	const unsigned char *p = data;
+	for (int i = 0; i < MAX_WALKERS; i++) {
+		Walker &walker = (*walkers)[i];
+		walker.type = p[10] | (p[11] << 8);
+		walker.x = p[20] | (p[21] << 8);
+		walker.y = p[22] | (p[23] << 8);
+		p += 388;
 	}
-	return walkers;
 }
 
 /**
-* Gets the building info from the saved game
+* Reads the building info from the decompressed building table
 */
-Building * ZeusFile::getBuildings() {
-	Building *buildings = new Building[MAX_BUILDINGS];
-	int length = readInt();
-	try {
-		PKWareInputStream pk(in, false, length);
-		
-		// Building entry = 280 bytes
-		for (int i = 0; i < MAX_BUILDINGS; i++) {
-			pk.skip(3);
-			buildings[i].size = pk.readByte();
-			pk.skip(2);
-			buildings[i].x = pk.readShort();
-			buildings[i].y = pk.readShort();
-			pk.skip(6);
-			buildings[i].type = pk.readShort();
-			pk.skip(154);
-			buildings[i].rotation = pk.readByte();
-			pk.skip(107);
+void ZeusFile::readBuildings(const unsigned char *data, BuildingTable *buildings) {
+	Building building;
+	
+	// Building entry = 280 bytes
+	buildings->reserve(MAX_BUILDINGS);
+	const unsigned char *p = data;
+	for (int i = 0; i < MAX_BUILDINGS; i++, p += 280) {
+		building.type = p[16] | (p[17] << 8);
+		if (building.type == 0) {
+			// building slot unused
+			continue;
 		}
-		pk.empty();
-	} catch (PKException) {
-		delete buildings;
-		throw;
+		building.size = p[3];
+		building.x = p[6] | (p[7] << 8);
+		building.y = p[8] | (p[9] << 8);
+		building.rotation = p[172];
+		buildings->push_back(building);
 	}
-	return buildings;
 }
 
 /**
@@ -760,6 +696,51 @@ void ZeusFile::skipCompressed() {
 	in->seekg(skip, ios::cur);
 }
 
+/**
+* Queues the compressed data block at the current position for
+* decompression. Compressed chunks consist of a length followed by a
+* compressed chunk of that length
+* @param size Length of the decompressed data
+* @return int Index of the chunk in `chunks'
+*/
+int ZeusFile::queueCompressed(ChunkDecoder *chunks, int size) {
+	int length = readInt();
+	const unsigned char *chunk = getCompressedData(&length);
+	return chunks->add(chunk, length, size);
+}
+
+/**
+* Returns the compressed data block at the current position straight
+* from the mapped file, and moves the stream past it
+* @param length Length of the block. Shortened if the file ends early
+*/
+const unsigned char *ZeusFile::getCompressedData(int *length) {
+	int offset = in->tellg();
+	if (offset < 0 || offset > file->size()) {
+		offset = file->size();
+	}
+	if (*length < 0 || *length > file->size() - offset) {
+		*length = file->size() - offset;
+	}
+	in->seekg(offset + *length, ios::beg);
+	return file->data() + offset;
+}
+
+/**
+* Returns the uncompressed data at the current position straight from
+* the mapped file, and moves the stream past it
+* @param length Number of bytes needed
+* @throws const char* if the file ends before that
+*/
+const unsigned char *ZeusFile::getUncompressedData(int length) {
+	int offset = in->tellg();
+	if (offset < 0 || length > file->size() - offset) {
+		throw "Unexpected end of file";
+	}
+	in->seekg(offset + length, ios::beg);
+	return file->data() + offset;
+}
+
 /**
 * Reads an integer from the stream
 */
@@ -774,15 +755,6 @@ unsigned int ZeusFile::readInt() {
 	return number;
 }
 
-/**
-* Reads a short from the stream
-*/
-unsigned short ZeusFile::readShort() {
-	char data[2];
-	in->read(data, 2);
-	return (unsigned short)(data[0] + (data[1] << 8));
-}
-
 /**
 * Returns the bitmap coordinates for a given map coordinate
 */
@@ -827,24 +799,38 @@ bool ZeusFile::searchPattern(char pattern[], int length) {
 }
 
 int main(int argc, char **argv) {
-	if (argc != 3) {
-		cerr << "Usage: "<<argv[0] << " [zeus file] [png output file]" << endl;
+	// Optional compression preset before the file names
+	PNGCompression compression = PNGWriter::BALANCED;
+	int arg = 1;
+	if (argc == 5 && string(argv[1]) == "-c") {
+		if (!PNGWriter::preset(argv[2], &compression)) {
+			cerr << "Unknown compression preset: " << argv[2] << endl;
+			return 1;
+		}
+		arg = 3;
+	}
+	if (argc - arg != 2) {
+		cerr << "Usage: " << argv[0] << " [-c fast|balanced|smallest] [zeus file] [png output file]" << endl;
 		return 1;
 	}
 	try {
-		ZeusFile *zf = new ZeusFile(string(argv[1]));
-		int numMaps = zf->getNumMaps();
+		Arena arena;
+		ZeusFile zf(argv[arg], &arena);
+		int numMaps = zf.getNumMaps();
 		
-		if (zf->isAdventure()) {
+		if (zf.isAdventure()) {
 			for (int i = 0; i < numMaps; i++) {
-				PNGImage *img = zf->getImage();
+				// The previous map is gone, start over with its memory
+				arena.reset();
+				unique_ptr<IndexedPNGImage> img = zf.getImage();
 				if (img) {
+					img->setCompression(compression);
 					if (i) {
 						// Colony, add "Ci" before extension
-						string filename(argv[2]);
-						unsigned int pos = filename.find_last_of('.');
-						char colony[4];
-						sprintf(colony, "C%d", i);
+						string filename(argv[arg + 1]);
+						string::size_type pos = filename.find_last_of('.');
+						char colony[16];
+						snprintf(colony, sizeof(colony), "C%d", i);
 						if (pos == string::npos) {
 							filename.append(colony);
 						} else {
@@ -853,20 +839,18 @@ int main(int argc, char **argv) {
 						img->write(filename.c_str());
 					} else {
 						// Parent city
-						img->write(argv[2]);
+						img->write(argv[arg + 1]);
 					}
-					delete img;
 				}
 			}
 		} else {
-			PNGImage *img = zf->getImage();
+			unique_ptr<IndexedPNGImage> img = zf.getImage();
 			
 			if (img) {
-				img->write(argv[2]);
-				delete img;
+				img->setCompression(compression);
+				img->write(argv[arg + 1]);
 			}
 		}
-		delete zf;
 	} catch (...) {
 		cerr << "Couldn't process file. Make sure it's a valid Zeus file." << endl;
 		return 2;
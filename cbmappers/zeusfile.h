@@ -19,32 +19,22 @@
 #ifndef zeusfile_h
 #define zeusfile_h
 
-#include "pngimage.h"
-#include "grid.h"
+#include "indexedpngimage.h"
+#include "mapmodel.h"
+#include "mappedfile.h"
+#include "chunkdecoder.h"
 #include "zeuscolours.h"
 #include <string>
 #include <iostream>
-
-typedef struct {
-	unsigned short type;
-	unsigned short x;
-	unsigned short y;
-} Walker;
-
-typedef struct {
-	unsigned short type;
-	unsigned short x;
-	unsigned short y;
-	unsigned char size;
-	unsigned char rotation;
-} Building;
+#include <fstream>
+#include <memory>
+#include <vector>
 
 class ZeusFile {
 	public:
 		static const int MAX_MAPS = 5; // parent city + 4 colonies
 		
-		ZeusFile(std::string filename);
-		~ZeusFile();
+		ZeusFile(std::string filename, Arena *arena = NULL);
 		
 		/**
 		* Returns the number of maps in this file. Call this function
@@ -58,7 +48,12 @@ class ZeusFile {
 		* image can't be loaded for whatever reason.
 		* NOTE: call getNumMaps() before calling this function
 		*/
-		PNGImage *getImage();
+		std::unique_ptr<IndexedPNGImage> getImage();
+		
+		/**
+		* Parses the next map into a MapModel, like getImage().
+		*/
+		std::unique_ptr<MapModel> getModel();
 		
 		/**
 		* Returns whether this file is an adventure or not. Call
@@ -67,26 +62,27 @@ class ZeusFile {
 		bool isAdventure();
 		
 	private:
-		void placeBuildings(PNGImage *img, Building *buildings,
-			Grid<unsigned char> *edges, int mapsize, bool is_poseidon);
-		void placeBuilding(PNGImage *img, Grid<unsigned char> *edges,
+		std::unique_ptr<IndexedPNGImage> drawModel(const MapModel *model);
+		void placeBuildings(IndexedPNGImage *img, const MapModel *model);
+		void placeBuilding(IndexedPNGImage *img, const MapGrid<unsigned char> *edges,
 			int mapsize, int posX, int posY,
 			int sizeX, int sizeY, int c1, int c2, bool reverse);
 		void getTerrainColours(unsigned int terrain, unsigned char random,
 			unsigned char meadow, unsigned char scrub, unsigned char t_marble,
 			int *c1, int *c2);
-		Grid<unsigned char> *readCompressedByteGrid();
-		Grid<unsigned short> *readCompressedShortGrid();
-		Grid<unsigned int> *readCompressedIntGrid();
-		Grid<unsigned char> *readByteGrid();
-		Grid<unsigned short> *readShortGrid();
-		Grid<unsigned int> *readIntGrid();
-		Walker *getWalkers();
-		Building *getBuildings();
+		GridView<unsigned char> viewByteGrid(const unsigned char *data);
+		GridView<unsigned char> viewByteGrid();
+		GridView<unsigned int> viewIntGrid(const unsigned char *data);
+		GridView<unsigned int> viewIntGrid();
+		int queueWalkers(ChunkDecoder *chunks);
+		void readWalkers(const unsigned char *data, WalkerTable *walkers);
+		void readBuildings(const unsigned char *data, BuildingTable *buildings);
 		int getMapsize();
 		void skipCompressed();
+		int queueCompressed(ChunkDecoder *chunks, int size);
+		const unsigned char *getCompressedData(int *length);
+		const unsigned char *getUncompressedData(int length);
 		unsigned int readInt();
-		unsigned short readShort();
 		bool searchPattern(char pattern[], int length);
 		void getBitmapCoordinates(int x, int y, int mapsize, int *x_out, int *y_out);
 		
@@ -100,8 +96,10 @@ class ZeusFile {
 		int numMaps;
 		int retrievedMaps;
 		int positions[MAX_MAPS];
-		std::ifstream *in;
-		ZeusColours *colours;
+		std::unique_ptr<std::ifstream> in;
+		std::unique_ptr<MappedFile> file;
+		std::unique_ptr<ZeusColours> colours;
+		Arena *arena;
 };
 
 #endif /* zeusfile_h */